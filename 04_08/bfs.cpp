@@ -0,0 +1,381 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <random>
+#include <ranges>
+#include <thread>
+#include <vector>
+
+class Graph {
+public:
+    using EdgeId = size_t;
+    using VertexId = size_t;
+
+    const auto& GetOutgoingEdges(VertexId vertexId) const {
+        return adjList_[vertexId];
+    }
+
+    auto GetNeighbors(VertexId vertexId) const {
+        return std::views::transform(adjList_[vertexId], [this](EdgeId edgeId) {
+            return edges_[edgeId].target;
+        });
+    }
+
+    VertexId NumVertices() const {
+        return adjList_.size();
+    }
+
+    EdgeId NumEdges() const {
+        return edges_.size();
+    }
+
+private:
+    friend Graph ReadUndirectedGraph();
+    friend Graph RandomUndirectedGraph(VertexId numVertices, EdgeId numEdges, uint64_t seed);
+
+    VertexId AddVertex() {
+        adjList_.emplace_back();
+        return adjList_.size() - 1;
+    }
+
+    void AddEdge(VertexId from, VertexId to) {
+        auto id = edges_.size();
+        edges_.push_back({to});
+        adjList_[from].push_back(id);
+    }
+
+    struct Edge {
+        VertexId target;
+    };
+
+    std::vector<std::vector<EdgeId>> adjList_;
+    std::vector<Edge> edges_;
+};
+
+Graph ReadUndirectedGraph() {
+    Graph graph;
+    int nv, ne;
+    std::cin >> nv >> ne;
+    for (int i = 0; i < nv; ++i) {
+        graph.AddVertex();
+    }
+    for (int i = 0; i < ne; ++i) {
+        int from, to;
+        std::cin >> from >> to;
+        graph.AddEdge(from - 1, to - 1);
+        graph.AddEdge(to - 1, from - 1);
+    }
+    return graph;
+}
+
+Graph RandomUndirectedGraph(Graph::VertexId numVertices, Graph::EdgeId numEdges, uint64_t seed) {
+    Graph graph;
+    for (Graph::VertexId v = 0; v < numVertices; ++v) {
+        graph.AddVertex();
+    }
+    std::mt19937_64 gen(seed);
+    std::uniform_int_distribution<Graph::VertexId> dis(0, numVertices - 1);
+    for (Graph::EdgeId i = 0; i < numEdges; ++i) {
+        auto from = dis(gen);
+        auto to = dis(gen);
+        graph.AddEdge(from, to);
+        graph.AddEdge(to, from);
+    }
+    return graph;
+}
+
+/*
+ *  https://www.boost.org/doc/libs/1_65_1/libs/graph/doc/BFSVisitor.html
+ *
+ *  Events are delivered on the calling thread, one BFS level after another.
+ */
+class BfsVisitor {
+public:
+    using VertexId = Graph::VertexId;
+
+    virtual ~BfsVisitor() = default;
+
+    virtual void DiscoverVertex(VertexId) {}
+    virtual void TreeEdge(VertexId, VertexId) {}
+};
+
+using Distance = size_t;
+inline constexpr Distance UNREACHABLE = std::numeric_limits<Distance>::max();
+
+class Bitmap {
+public:
+    explicit Bitmap(size_t size) : words_((size + 63) / 64) {
+    }
+
+    bool Test(size_t index) const {
+        return words_[index / 64].load(std::memory_order_relaxed) & Bit(index);
+    }
+
+    // Returns true if the bit was not set before.
+    bool Set(size_t index) {
+        return !(words_[index / 64].fetch_or(Bit(index), std::memory_order_relaxed) & Bit(index));
+    }
+
+    void Clear() {
+        for (auto& word : words_) {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    size_t NumWords() const {
+        return words_.size();
+    }
+
+    // Calls `func(index)` for every set bit of words [beginWord, endWord) in ascending order.
+    template <class Func>
+    void ForEach(size_t beginWord, size_t endWord, Func func) const {
+        for (size_t w = beginWord; w < endWord; ++w) {
+            auto word = words_[w].load(std::memory_order_relaxed);
+            while (word) {
+                func(w * 64 + std::countr_zero(word));
+                word &= word - 1;
+            }
+        }
+    }
+
+    void Swap(Bitmap& other) {
+        words_.swap(other.words_);
+    }
+
+private:
+    static uint64_t Bit(size_t index) {
+        return uint64_t(1) << (index % 64);
+    }
+
+    std::vector<std::atomic<uint64_t>> words_;
+};
+
+// Splits [0, size) into `numThreads` chunks and runs `func(begin, end)` on each in parallel.
+template <class Func>
+void ParallelFor(size_t numThreads, size_t size, Func func) {
+    numThreads = std::max<size_t>(1, std::min(numThreads, size));
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < numThreads; ++t) {
+        threads.emplace_back(func, size * t / numThreads, size * (t + 1) / numThreads);
+    }
+    func(0, size / numThreads);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+/*
+ * Direction-optimizing BFS (S. Beamer, K. Asanovic, D. Patterson, 2012).
+ *
+ * Top-down steps scan the out-edges of the frontier; once the frontier has
+ * more out-edges than 1/ALPHA of the edges still unexplored, bottom-up steps
+ * let every unvisited vertex look for any parent in the frontier instead and
+ * stop at the first one. It switches back when the frontier shrinks below
+ * 1/BETA of the vertices. Frontiers are bitmaps split between threads by words.
+ *
+ * Any shortest-path parent may be chosen, so parents can differ between runs.
+ */
+class DirectionOptimizingBfs {
+public:
+    static constexpr inline size_t ALPHA = 14;
+    static constexpr inline size_t BETA = 24;
+
+    explicit DirectionOptimizingBfs(size_t numThreads = std::thread::hardware_concurrency())
+        : numThreads_(std::max<size_t>(1, numThreads))
+    {
+    }
+
+    auto operator()(const Graph& graph, Graph::VertexId source, BfsVisitor& visitor) const {
+        auto numVertices = graph.NumVertices();
+        std::vector<Distance> distances(numVertices, UNREACHABLE);
+        std::vector<Graph::VertexId> parents(numVertices, -1);
+        Bitmap visited(numVertices);
+        Bitmap frontier(numVertices);
+        Bitmap next(numVertices);
+
+        distances[source] = 0;
+        visited.Set(source);
+        frontier.Set(source);
+        visitor.DiscoverVertex(source);
+
+        size_t frontierEdges = graph.GetOutgoingEdges(source).size();
+        size_t frontierVertices = 1;
+        size_t unexploredEdges = graph.NumEdges() - frontierEdges;
+        bool bottomUp = false;
+
+        for (Distance level = 0; frontierVertices > 0; ++level) {
+            if (!bottomUp && frontierEdges > unexploredEdges / ALPHA) {
+                bottomUp = true;
+            } else if (bottomUp && frontierVertices < numVertices / BETA) {
+                bottomUp = false;
+            }
+
+            std::atomic<size_t> nextEdges = 0;
+            std::atomic<size_t> nextVertices = 0;
+            auto step = [&](size_t beginWord, size_t endWord) {
+                size_t edges = 0;
+                size_t vertices = 0;
+                auto discover = [&](Graph::VertexId vertex, Graph::VertexId parent) {
+                    parents[vertex] = parent;
+                    distances[vertex] = level + 1;
+                    next.Set(vertex);
+                    edges += graph.GetOutgoingEdges(vertex).size();
+                    ++vertices;
+                };
+                if (bottomUp) {
+                    auto end = std::min(endWord * 64, numVertices);
+                    for (auto vertex = beginWord * 64; vertex < end; ++vertex) {
+                        if (visited.Test(vertex)) {
+                            continue;
+                        }
+                        for (Graph::VertexId neighbor : graph.GetNeighbors(vertex)) {
+                            if (frontier.Test(neighbor)) {
+                                visited.Set(vertex);
+                                discover(vertex, neighbor);
+                                break;
+                            }
+                        }
+                    }
+                } else {
+                    frontier.ForEach(beginWord, endWord, [&](Graph::VertexId vertex) {
+                        for (Graph::VertexId neighbor : graph.GetNeighbors(vertex)) {
+                            if (!visited.Test(neighbor) && visited.Set(neighbor)) {
+                                discover(neighbor, vertex);
+                            }
+                        }
+                    });
+                }
+                nextEdges += edges;
+                nextVertices += vertices;
+            };
+            ParallelFor(numThreads_, frontier.NumWords(), step);
+
+            next.ForEach(0, next.NumWords(), [&](Graph::VertexId vertex) {
+                visitor.TreeEdge(parents[vertex], vertex);
+                visitor.DiscoverVertex(vertex);
+            });
+
+            frontierEdges = nextEdges;
+            frontierVertices = nextVertices;
+            unexploredEdges -= std::min(unexploredEdges, frontierEdges);
+            frontier.Swap(next);
+            next.Clear();
+        }
+        return std::make_pair(distances, parents);
+    }
+
+private:
+    size_t numThreads_;
+};
+
+auto SequentialBfs(const Graph& graph, Graph::VertexId source, BfsVisitor& visitor) {
+    std::vector<Distance> distances(graph.NumVertices(), UNREACHABLE);
+    std::vector<Graph::VertexId> parents(graph.NumVertices(), -1);
+    distances[source] = 0;
+    visitor.DiscoverVertex(source);
+
+    std::queue<Graph::VertexId> queue;
+    queue.push(source);
+    while (!queue.empty()) {
+        auto vertex = queue.front();
+        queue.pop();
+        for (Graph::VertexId neighbor : graph.GetNeighbors(vertex)) {
+            if (distances[neighbor] == UNREACHABLE) {
+                distances[neighbor] = distances[vertex] + 1;
+                parents[neighbor] = vertex;
+                visitor.TreeEdge(vertex, neighbor);
+                visitor.DiscoverVertex(neighbor);
+                queue.push(neighbor);
+            }
+        }
+    }
+    return std::make_pair(distances, parents);
+}
+
+class LevelCheckVisitor : public BfsVisitor {
+public:
+    explicit LevelCheckVisitor(VertexId numVertices) : discovered_(numVertices) {
+    }
+
+    void DiscoverVertex(VertexId vertex) override {
+        assert(!discovered_[vertex]);
+        discovered_[vertex] = true;
+        ++numDiscovered_;
+    }
+
+    void TreeEdge([[maybe_unused]] VertexId from, [[maybe_unused]] VertexId to) override {
+        assert(discovered_[from]);
+        assert(!discovered_[to]);
+    }
+
+    size_t numDiscovered_ = 0;
+
+private:
+    std::vector<bool> discovered_;
+};
+
+void StressTest() {
+    std::mt19937 gen;
+    for (int test = 0; test < 200; ++test) {
+        Graph::VertexId numVertices = 1 + gen() % 300;
+        Graph::EdgeId numEdges = gen() % (4 * numVertices);
+        auto graph = RandomUndirectedGraph(numVertices, numEdges, test);
+        auto source = gen() % numVertices;
+
+        BfsVisitor visitor;
+        auto [expected, _] = SequentialBfs(graph, source, visitor);
+
+        LevelCheckVisitor checker(numVertices);
+        auto [distances, parents] = DirectionOptimizingBfs(1 + test % 4)(graph, source, checker);
+        assert(distances == expected);
+        assert(checker.numDiscovered_ == size_t(std::ranges::count_if(distances, [](Distance distance) {
+            return distance != UNREACHABLE;
+        })));
+        for (Graph::VertexId vertex = 0; vertex < numVertices; ++vertex) {
+            if (vertex == source || distances[vertex] == UNREACHABLE) {
+                continue;
+            }
+            [[maybe_unused]] auto parent = parents[vertex];
+            assert(distances[parent] + 1 == distances[vertex]);
+            assert(std::ranges::count(graph.GetNeighbors(vertex), parent) > 0);
+        }
+    }
+}
+
+template <class Bfs>
+double MeasureSeconds(Bfs bfs, const Graph& graph, Graph::VertexId source, size_t& reached) {
+    BfsVisitor visitor;
+    auto start = std::chrono::steady_clock::now();
+    auto [distances, _] = bfs(graph, source, visitor);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    reached = std::ranges::count_if(distances, [](Distance distance) {
+        return distance != UNREACHABLE;
+    });
+    return elapsed.count();
+}
+
+void Benchmark(Graph::VertexId numVertices, Graph::EdgeId averageDegree) {
+    auto graph = RandomUndirectedGraph(numVertices, numVertices * averageDegree / 2, 1);
+    size_t reached = 0;
+    auto sequential = MeasureSeconds(SequentialBfs, graph, 0, reached);
+    std::cout << numVertices << " vertices, " << graph.NumEdges() << " arcs, " << reached <<
+        " reached: sequential " << sequential * 1e3 << " ms\n";
+
+    auto maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+        auto seconds = MeasureSeconds(DirectionOptimizingBfs(numThreads), graph, 0, reached);
+        std::cout << "  direction-optimizing, " << numThreads << " threads: " << seconds * 1e3 <<
+            " ms, speedup " << sequential / seconds << "x\n";
+    }
+}
+
+int main() {
+    StressTest();
+    Benchmark(1 << 18, 16);
+}
@@ -0,0 +1,432 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+class Graph {
+public:
+    using EdgeId = size_t;
+    using VertexId = size_t;
+
+    const auto& GetOutgoingEdges(VertexId vertexId) const {
+        return adjList_[vertexId];
+    }
+
+    auto GetNeighbors(VertexId vertexId) const {
+        return std::views::transform(adjList_[vertexId], [this](EdgeId edgeId) {
+            return edges_[edgeId].target;
+        });
+    }
+
+    VertexId NumVertices() const {
+        return adjList_.size();
+    }
+
+    EdgeId NumEdges() const {
+        return edges_.size();
+    }
+
+    size_t MemoryBytes() const {
+        size_t bytes = adjList_.capacity() * sizeof(adjList_[0]) + edges_.capacity() * sizeof(Edge);
+        for (const auto& edgeIds : adjList_) {
+            bytes += edgeIds.capacity() * sizeof(EdgeId);
+        }
+        return bytes;
+    }
+
+private:
+    friend Graph ReadUndirectedGraph();
+    friend Graph RandomUndirectedGraph(VertexId numVertices, EdgeId numEdges, uint64_t seed);
+
+    VertexId AddVertex() {
+        adjList_.emplace_back();
+        return adjList_.size() - 1;
+    }
+
+    void AddEdge(VertexId from, VertexId to) {
+        auto id = edges_.size();
+        edges_.push_back({to});
+        adjList_[from].push_back(id);
+    }
+
+    struct Edge {
+        VertexId target;
+    };
+
+    std::vector<std::vector<EdgeId>> adjList_;
+    std::vector<Edge> edges_;
+};
+
+Graph ReadUndirectedGraph() {
+    Graph graph;
+    int nv, ne;
+    std::cin >> nv >> ne;
+    for (int i = 0; i < nv; ++i) {
+        graph.AddVertex();
+    }
+    for (int i = 0; i < ne; ++i) {
+        int from, to;
+        std::cin >> from >> to;
+        graph.AddEdge(from - 1, to - 1);
+        graph.AddEdge(to - 1, from - 1);
+    }
+    return graph;
+}
+
+Graph RandomUndirectedGraph(Graph::VertexId numVertices, Graph::EdgeId numEdges, uint64_t seed) {
+    Graph graph;
+    for (Graph::VertexId v = 0; v < numVertices; ++v) {
+        graph.AddVertex();
+    }
+    std::mt19937_64 gen(seed);
+    std::uniform_int_distribution<Graph::VertexId> dis(0, numVertices - 1);
+    for (Graph::EdgeId i = 0; i < numEdges; ++i) {
+        auto from = dis(gen);
+        auto to = dis(gen);
+        graph.AddEdge(from, to);
+        graph.AddEdge(to, from);
+    }
+    return graph;
+}
+
+std::vector<Graph::VertexId> SortedNeighbors(const Graph& graph, Graph::VertexId vertex) {
+    auto neighbors = graph.GetNeighbors(vertex);
+    std::vector<Graph::VertexId> sorted(neighbors.begin(), neighbors.end());
+    std::sort(sorted.begin(), sorted.end());
+    return sorted;
+}
+
+/*
+ * Compressed sparse rows with neighbor ids narrowed to 32 bits:
+ * 4 bytes per edge plus 8 per vertex, decoding is a plain array read.
+ */
+class NarrowGraph {
+public:
+    using VertexId = size_t;
+    using NarrowId = uint32_t;
+
+    // Throws std::length_error if some vertex id does not fit into NarrowId.
+    explicit NarrowGraph(const Graph& graph) : offsets_{0} {
+        if (graph.NumVertices() > size_t(std::numeric_limits<NarrowId>::max()) + 1) {
+            throw std::length_error("NarrowGraph: vertex ids do not fit into 32 bits");
+        }
+        offsets_.reserve(graph.NumVertices() + 1);
+        targets_.reserve(graph.NumEdges());
+        for (VertexId vertex = 0; vertex < graph.NumVertices(); ++vertex) {
+            for (auto neighbor : SortedNeighbors(graph, vertex)) {
+                targets_.push_back(neighbor);
+            }
+            offsets_.push_back(targets_.size());
+        }
+    }
+
+    std::span<const NarrowId> GetNeighbors(VertexId vertexId) const {
+        return {targets_.data() + offsets_[vertexId], targets_.data() + offsets_[vertexId + 1]};
+    }
+
+    VertexId NumVertices() const {
+        return offsets_.size() - 1;
+    }
+
+    size_t MemoryBytes() const {
+        return offsets_.capacity() * sizeof(offsets_[0]) + targets_.capacity() * sizeof(NarrowId);
+    }
+
+private:
+    std::vector<size_t> offsets_;
+    std::vector<NarrowId> targets_;
+};
+
+/*
+ * Compressed sparse rows with every neighbor list sorted and stored as
+ * LEB128 varint gaps: the first neighbor relative to the vertex itself
+ * (zigzag-encoded, it may be smaller), the others relative to the previous
+ * neighbor. Small gaps take a single byte. GetNeighbors decodes lazily
+ * while it is iterated.
+ */
+class CompressedGraph {
+public:
+    using VertexId = size_t;
+
+    class NeighborIterator {
+    public:
+        using value_type = VertexId;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::input_iterator_tag;
+
+        NeighborIterator() = default;
+
+        NeighborIterator(const uint8_t* pos, const uint8_t* end, VertexId source)
+            : pos_(pos), end_(end)
+        {
+            if (pos_ != end_) {
+                current_ = source + ZigZagDecode(ReadVarint(pos_));
+                done_ = false;
+            }
+        }
+
+        VertexId operator*() const {
+            return current_;
+        }
+
+        NeighborIterator& operator++() {
+            if (pos_ == end_) {
+                done_ = true;
+            } else {
+                current_ += ReadVarint(pos_);
+            }
+            return *this;
+        }
+
+        void operator++(int) {
+            ++*this;
+        }
+
+        bool operator==(std::default_sentinel_t) const {
+            return done_;
+        }
+
+    private:
+        const uint8_t* pos_ = nullptr;
+        const uint8_t* end_ = nullptr;
+        VertexId current_ = 0;
+        bool done_ = true;
+    };
+
+    class NeighborRange {
+    public:
+        NeighborRange(const uint8_t* begin, const uint8_t* end, VertexId source)
+            : begin_(begin), end_(end), source_(source)
+        {
+        }
+
+        NeighborIterator begin() const {
+            return {begin_, end_, source_};
+        }
+
+        std::default_sentinel_t end() const {
+            return {};
+        }
+
+    private:
+        const uint8_t* begin_;
+        const uint8_t* end_;
+        VertexId source_;
+    };
+
+    explicit CompressedGraph(const Graph& graph) : offsets_{0} {
+        offsets_.reserve(graph.NumVertices() + 1);
+        for (VertexId vertex = 0; vertex < graph.NumVertices(); ++vertex) {
+            auto neighbors = SortedNeighbors(graph, vertex);
+            if (!neighbors.empty()) {
+                WriteVarint(ZigZagEncode(neighbors[0] - vertex));
+            }
+            for (size_t i = 1; i < neighbors.size(); ++i) {
+                WriteVarint(neighbors[i] - neighbors[i - 1]);
+            }
+            offsets_.push_back(bytes_.size());
+        }
+        bytes_.shrink_to_fit();
+    }
+
+    NeighborRange GetNeighbors(VertexId vertexId) const {
+        return {bytes_.data() + offsets_[vertexId], bytes_.data() + offsets_[vertexId + 1], vertexId};
+    }
+
+    VertexId NumVertices() const {
+        return offsets_.size() - 1;
+    }
+
+    size_t MemoryBytes() const {
+        return offsets_.capacity() * sizeof(offsets_[0]) + bytes_.capacity();
+    }
+
+private:
+    static uint64_t ZigZagEncode(uint64_t delta) {
+        auto value = static_cast<int64_t>(delta);
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    static uint64_t ZigZagDecode(uint64_t value) {
+        return (value >> 1) ^ (~(value & 1) + 1);
+    }
+
+    static uint64_t ReadVarint(const uint8_t*& pos) {
+        uint64_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            auto byte = *pos++;
+            value |= uint64_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+    }
+
+    void WriteVarint(uint64_t value) {
+        while (value >= 0x80) {
+            bytes_.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        bytes_.push_back(static_cast<uint8_t>(value));
+    }
+
+    std::vector<size_t> offsets_;
+    std::vector<uint8_t> bytes_;
+};
+
+enum class Color {
+    WHITE,
+    GRAY,
+    BLACK,
+};
+
+/*
+ *  https://www.boost.org/doc/libs/1_65_1/libs/graph/doc/DFSVisitor.html
+ *  https://www.boost.org/doc/libs/1_65_1/libs/graph/doc/depth_first_search.html
+ */
+class Visitor {
+public:
+    using VertexId = Graph::VertexId;
+
+    virtual ~Visitor() = default;
+
+    virtual void DiscoverVertex(VertexId) {}
+    virtual void FinishVertex(VertexId) {}
+
+    virtual void TreeEdge(VertexId, VertexId) {}
+    virtual void BackEdge(VertexId, VertexId) {}
+    virtual void ForwardOrCrossEdge(VertexId, VertexId) {}
+};
+
+class OrderVisitor : public Visitor {
+public:
+    void DiscoverVertex(VertexId vertex) override {
+        order_.push_back(vertex);
+    }
+
+    void TreeEdge(VertexId from, VertexId to) override {
+        order_.push_back(from);
+        order_.push_back(to);
+    }
+
+    std::vector<VertexId> order_;
+};
+
+/*
+ * Works with any graph type whose GetNeighbors returns a range of vertex ids.
+ * The search keeps its own stack, so its depth is not bounded by the call stack:
+ * a random graph of a few thousand vertices already has a DFS path through most of them.
+ */
+template <class AnyGraph>
+void Dfs(const AnyGraph& graph, Graph::VertexId root, std::vector<Color>& colors, Visitor& visitor) {
+    using Neighbors = decltype(graph.GetNeighbors(root));
+    struct Frame {
+        Graph::VertexId vertex;
+        Neighbors neighbors;
+        std::ranges::iterator_t<Neighbors> next;
+    };
+    // A deque never moves its elements, so `next` keeps pointing into `neighbors`.
+    std::deque<Frame> stack;
+    auto discover = [&](Graph::VertexId vertex) {
+        visitor.DiscoverVertex(vertex);
+        colors[vertex] = Color::GRAY;
+        auto& frame = stack.emplace_back(Frame{vertex, graph.GetNeighbors(vertex), {}});
+        frame.next = frame.neighbors.begin();
+    };
+
+    discover(root);
+    while (!stack.empty()) {
+        auto& frame = stack.back();
+        if (frame.next == frame.neighbors.end()) {
+            visitor.FinishVertex(frame.vertex);
+            colors[frame.vertex] = Color::BLACK;
+            stack.pop_back();
+            continue;
+        }
+        Graph::VertexId neighbor = *frame.next;
+        ++frame.next;
+        if (colors[neighbor] == Color::WHITE) {
+            visitor.TreeEdge(frame.vertex, neighbor);
+            discover(neighbor);
+        } else if (colors[neighbor] == Color::GRAY) {
+            visitor.BackEdge(frame.vertex, neighbor);
+        } else {
+            visitor.ForwardOrCrossEdge(frame.vertex, neighbor);
+        }
+    }
+}
+
+template <class AnyGraph>
+void Dfs(const AnyGraph& graph, Visitor& visitor) {
+    std::vector<Color> colors(graph.NumVertices());
+    for (Graph::VertexId vertex = 0; vertex < graph.NumVertices(); ++vertex) {
+        if (colors[vertex] == Color::WHITE) {
+            Dfs(graph, vertex, colors, visitor);
+        }
+    }
+}
+
+void StressTest() {
+    std::mt19937 gen;
+    for (int test = 0; test < 200; ++test) {
+        Graph::VertexId numVertices = 1 + gen() % 300;
+        auto graph = RandomUndirectedGraph(numVertices, gen() % (4 * numVertices), test);
+        NarrowGraph narrow(graph);
+        CompressedGraph compressed(graph);
+        assert(narrow.NumVertices() == numVertices);
+        assert(compressed.NumVertices() == numVertices);
+        for (Graph::VertexId vertex = 0; vertex < numVertices; ++vertex) {
+            auto expected = SortedNeighbors(graph, vertex);
+            assert(std::ranges::equal(narrow.GetNeighbors(vertex), expected));
+            assert(std::ranges::equal(compressed.GetNeighbors(vertex), expected));
+        }
+
+        OrderVisitor narrowOrder;
+        Dfs(narrow, narrowOrder);
+        OrderVisitor compressedOrder;
+        Dfs(compressed, compressedOrder);
+        assert(narrowOrder.order_ == compressedOrder.order_);
+    }
+}
+
+template <class AnyGraph>
+double DfsSeconds(const AnyGraph& graph, int repetitions) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; ++i) {
+        Visitor visitor;
+        Dfs(graph, visitor);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / repetitions;
+}
+
+void Benchmark(Graph::VertexId numVertices, Graph::EdgeId averageDegree, int repetitions = 10) {
+    auto graph = RandomUndirectedGraph(numVertices, numVertices * averageDegree / 2, 1);
+    NarrowGraph narrow(graph);
+    CompressedGraph compressed(graph);
+
+    auto numEdges = double(graph.NumEdges());
+    auto baseline = DfsSeconds(graph, repetitions);
+    auto report = [&](const char* name, size_t bytes, double seconds) {
+        std::cout << "  " << name << ": " << bytes / numEdges << " bytes/edge, Dfs " <<
+            seconds * 1e3 << " ms (" << seconds / baseline << "x)\n";
+    };
+    std::cout << numVertices << " vertices, " << graph.NumEdges() << " arcs\n";
+    report("Graph", graph.MemoryBytes(), baseline);
+    report("NarrowGraph", narrow.MemoryBytes(), DfsSeconds(narrow, repetitions));
+    report("CompressedGraph", compressed.MemoryBytes(), DfsSeconds(compressed, repetitions));
+}
+
+int main() {
+    StressTest();
+    Benchmark(1 << 14, 32);
+}
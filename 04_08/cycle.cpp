@@ -1,3 +1,5 @@
+#include "common/stats.h"
+
 #include <iostream>
 #include <vector>
 #include <ranges>
@@ -140,6 +142,7 @@ public:
 };
 
 void Dfs(const Graph& graph, Graph::VertexId vertex, std::vector<Color>& colors, Visitor& visitor) {
+    STATS_TRACK_DEPTH("dfs.max_depth");
     visitor.DiscoverVertex(vertex);
     colors[vertex] = Color::GRAY;
     for (Graph::VertexId neighbor : graph.GetNeighbors(vertex)) {
@@ -201,9 +204,14 @@ int main() {
     auto graph = ReadAdjMatrix();
     CycleVisitor visitor(graph.NumVertices());
 
-    Dfs(graph, visitor);
+    {
+        STATS_SCOPED_TIMER("dfs");
+        STATS_SCOPED_PERF("dfs");
+        Dfs(graph, visitor);
+    }
 
     visitor.PrintCycle();
+    STATS_DUMP_JSON(std::cerr);
 }
 
 
@@ -0,0 +1,525 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <ranges>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class Graph {
+public:
+    using EdgeId = size_t;
+    using VertexId = size_t;
+
+    const auto& GetOutgoingEdges(VertexId vertexId) const {
+        return adjList_[vertexId];
+    }
+
+    auto GetNeighbors(VertexId vertexId) const {
+        return std::views::transform(adjList_[vertexId], [this](EdgeId edgeId) {
+            return edges_[edgeId].target;
+        });
+    }
+
+    VertexId NumVertices() const {
+        return adjList_.size();
+    }
+
+private:
+    friend class NaiveCycleDetector;
+
+    VertexId AddVertex() {
+        adjList_.emplace_back();
+        return adjList_.size() - 1;
+    }
+
+    void AddEdge(VertexId from, VertexId to) {
+        auto id = edges_.size();
+        edges_.push_back({to});
+        adjList_[from].push_back(id);
+    }
+
+    struct Edge {
+        VertexId target;
+    };
+
+    std::vector<std::vector<EdgeId>> adjList_;
+    std::vector<Edge> edges_;
+};
+
+enum class Color {
+    WHITE,
+    GRAY,
+    BLACK,
+};
+
+/*
+ *  https://www.boost.org/doc/libs/1_65_1/libs/graph/doc/DFSVisitor.html
+ *  https://www.boost.org/doc/libs/1_65_1/libs/graph/doc/depth_first_search.html
+ */
+class Visitor {
+public:
+    using VertexId = Graph::VertexId;
+
+    virtual ~Visitor() = default;
+
+    virtual void DiscoverVertex(VertexId) {}
+    virtual void FinishVertex(VertexId) {}
+
+    virtual void TreeEdge(VertexId, VertexId) {}
+    virtual void BackEdge(VertexId, VertexId) {}
+    virtual void ForwardOrCrossEdge(VertexId, VertexId) {}
+};
+
+void Dfs(const Graph& graph, Graph::VertexId vertex, std::vector<Color>& colors, Visitor& visitor) {
+    visitor.DiscoverVertex(vertex);
+    colors[vertex] = Color::GRAY;
+    for (Graph::VertexId neighbor : graph.GetNeighbors(vertex)) {
+        if (colors[neighbor] == Color::WHITE) {
+            visitor.TreeEdge(vertex, neighbor);
+            Dfs(graph, neighbor, colors, visitor);
+        } else if (colors[neighbor] == Color::GRAY) {
+            visitor.BackEdge(vertex, neighbor);
+        } else {
+            visitor.ForwardOrCrossEdge(vertex, neighbor);
+        }
+    }
+    visitor.FinishVertex(vertex);
+    colors[vertex] = Color::BLACK;
+}
+
+using Cycle = std::vector<Graph::VertexId>;
+
+/*
+ * Same output as CycleVisitor::PrintCycle: the cycle is listed against the
+ * direction of its edges, i.e. cycle[i + 1] -> cycle[i] and cycle[0] -> cycle.back().
+ */
+void PrintCycle(const Cycle& cycle) {
+    if (cycle.empty()) {
+        std::cout << "NO\n";
+    } else {
+        std::cout << "YES\n";
+        std::cout << cycle.size() << "\n";
+        for (auto vertex : cycle) {
+            std::cout << vertex + 1 << ' ';
+        }
+        std::cout << std::endl;
+    }
+}
+
+/*
+ * Undirected graph that only accepts edges keeping it a forest.
+ * Connectivity is answered by union-find in amortized almost O(1). The forest
+ * is also kept rooted, the smaller tree being rerooted on every link (O(log V)
+ * amortized per vertex), so a rejected edge reports its cycle in O(cycle length).
+ */
+class UndirectedCycleDetector {
+public:
+    using VertexId = Graph::VertexId;
+
+    explicit UndirectedCycleDetector(VertexId numVertices)
+        : parents_(numVertices), sizes_(numVertices, 1), forest_(numVertices),
+          treeParents_(numVertices), depths_(numVertices)
+    {
+        std::iota(parents_.begin(), parents_.end(), 0);
+        std::iota(treeParents_.begin(), treeParents_.end(), 0);
+    }
+
+    // Adds the edge and returns an empty cycle, or returns the cycle it would close and leaves the graph as is.
+    Cycle TryAddEdge(VertexId from, VertexId to) {
+        auto fromRoot = FindRoot(from);
+        auto toRoot = FindRoot(to);
+        if (fromRoot == toRoot) {
+            return FindPath(from, to);
+        }
+        if (sizes_[fromRoot] < sizes_[toRoot]) {
+            std::swap(fromRoot, toRoot);
+            std::swap(from, to);
+        }
+        parents_[toRoot] = fromRoot;
+        sizes_[fromRoot] += sizes_[toRoot];
+        HangTree(to, from);
+        forest_[from].push_back(to);
+        forest_[to].push_back(from);
+        return {};
+    }
+
+private:
+    VertexId FindRoot(VertexId vertex) {
+        auto root = vertex;
+        while (parents_[root] != root) {
+            root = parents_[root];
+        }
+        while (parents_[vertex] != root) {
+            vertex = std::exchange(parents_[vertex], root);
+        }
+        return root;
+    }
+
+    // Reroots the tree of `vertex` at it and makes it a child of `parent`.
+    void HangTree(VertexId vertex, VertexId parent) {
+        treeParents_[vertex] = parent;
+        depths_[vertex] = depths_[parent] + 1;
+        std::vector<VertexId> queue{vertex};
+        for (size_t i = 0; i < queue.size(); ++i) {
+            auto current = queue[i];
+            for (auto neighbor : forest_[current]) {
+                if (neighbor != treeParents_[current]) {
+                    treeParents_[neighbor] = current;
+                    depths_[neighbor] = depths_[current] + 1;
+                    queue.push_back(neighbor);
+                }
+            }
+        }
+    }
+
+    // The forest path from `from` to `to`, listed starting at `from`.
+    Cycle FindPath(VertexId from, VertexId to) const {
+        Cycle cycle{from};
+        Cycle tail{to};
+        while (cycle.back() != tail.back()) {
+            if (depths_[cycle.back()] >= depths_[tail.back()]) {
+                cycle.push_back(treeParents_[cycle.back()]);
+            } else {
+                tail.push_back(treeParents_[tail.back()]);
+            }
+        }
+        cycle.insert(cycle.end(), std::next(tail.rbegin()), tail.rend());
+        return cycle;
+    }
+
+    std::vector<VertexId> parents_;
+    std::vector<size_t> sizes_;
+    std::vector<std::vector<VertexId>> forest_;
+
+    std::vector<VertexId> treeParents_;
+    std::vector<size_t> depths_;
+};
+
+/*
+ * Directed graph that only accepts edges keeping it acyclic, maintaining a
+ * topological order online (D. Pearce, P. Kelly, "A dynamic topological sort
+ * algorithm for directed acyclic graphs", 2006).
+ *
+ * An edge that agrees with the current order is added in O(1). Otherwise only
+ * the vertices between its endpoints in the order are searched: forward from
+ * the target (a cycle if it reaches the source) and backward from the source,
+ * and the two sets swap their positions.
+ */
+class DirectedCycleDetector {
+public:
+    using VertexId = Graph::VertexId;
+
+    explicit DirectedCycleDetector(VertexId numVertices)
+        : order_(numVertices), outgoing_(numVertices), incoming_(numVertices),
+          marks_(numVertices), searchParents_(numVertices)
+    {
+        std::iota(order_.begin(), order_.end(), 0);
+    }
+
+    // Adds the edge and returns an empty cycle, or returns the cycle it would close and leaves the graph as is.
+    Cycle TryAddEdge(VertexId from, VertexId to) {
+        if (from == to) {
+            return {from};
+        }
+        if (order_[from] > order_[to]) {
+            if (auto cycle = SearchForward(from, to); !cycle.empty()) {
+                return cycle;
+            }
+            SearchBackward(from, to);
+            Reorder();
+        }
+        outgoing_[from].push_back(to);
+        incoming_[to].push_back(from);
+        return {};
+    }
+
+    // Position of `vertex` in the current topological order.
+    size_t GetOrder(VertexId vertex) const {
+        return order_[vertex];
+    }
+
+private:
+    // Collects everything reachable from `to` that precedes `from`; returns the cycle if `from` is among them.
+    Cycle SearchForward(VertexId from, VertexId to) {
+        ++mark_;
+        forward_.clear();
+        std::vector<VertexId> stack{to};
+        marks_[to] = mark_;
+        while (!stack.empty()) {
+            auto vertex = stack.back();
+            stack.pop_back();
+            forward_.push_back(vertex);
+            for (auto next : outgoing_[vertex]) {
+                if (next == from) {
+                    Cycle cycle{from, vertex};
+                    while (cycle.back() != to) {
+                        cycle.push_back(searchParents_[cycle.back()]);
+                    }
+                    return cycle;
+                }
+                if (marks_[next] != mark_ && order_[next] < order_[from]) {
+                    marks_[next] = mark_;
+                    searchParents_[next] = vertex;
+                    stack.push_back(next);
+                }
+            }
+        }
+        return {};
+    }
+
+    // Collects everything that reaches `from` and follows `to`.
+    void SearchBackward(VertexId from, VertexId to) {
+        ++mark_;
+        backward_.clear();
+        std::vector<VertexId> stack{from};
+        marks_[from] = mark_;
+        while (!stack.empty()) {
+            auto vertex = stack.back();
+            stack.pop_back();
+            backward_.push_back(vertex);
+            for (auto previous : incoming_[vertex]) {
+                if (marks_[previous] != mark_ && order_[previous] > order_[to]) {
+                    marks_[previous] = mark_;
+                    stack.push_back(previous);
+                }
+            }
+        }
+    }
+
+    // Hands the positions held by both sets to the backward set first, then to the forward one.
+    void Reorder() {
+        auto byOrder = [this](VertexId lhs, VertexId rhs) {
+            return order_[lhs] < order_[rhs];
+        };
+        std::sort(backward_.begin(), backward_.end(), byOrder);
+        std::sort(forward_.begin(), forward_.end(), byOrder);
+
+        positions_.clear();
+        for (auto vertex : backward_) {
+            positions_.push_back(order_[vertex]);
+        }
+        for (auto vertex : forward_) {
+            positions_.push_back(order_[vertex]);
+        }
+        std::sort(positions_.begin(), positions_.end());
+
+        size_t i = 0;
+        for (auto vertex : backward_) {
+            order_[vertex] = positions_[i++];
+        }
+        for (auto vertex : forward_) {
+            order_[vertex] = positions_[i++];
+        }
+    }
+
+    std::vector<size_t> order_;
+    std::vector<std::vector<VertexId>> outgoing_;
+    std::vector<std::vector<VertexId>> incoming_;
+
+    std::vector<size_t> marks_;
+    size_t mark_ = 0;
+    std::vector<VertexId> searchParents_;
+    std::vector<VertexId> forward_;
+    std::vector<VertexId> backward_;
+    std::vector<size_t> positions_;
+};
+
+class ReachVisitor : public Visitor {
+public:
+    explicit ReachVisitor(VertexId target) : target_(target) {
+    }
+
+    void DiscoverVertex(VertexId vertex) override {
+        reached_ = reached_ || vertex == target_;
+    }
+
+    VertexId target_;
+    bool reached_ = false;
+};
+
+// The baseline: a full Dfs before every insertion.
+class NaiveCycleDetector {
+public:
+    using VertexId = Graph::VertexId;
+
+    NaiveCycleDetector(VertexId numVertices, bool directed) : directed_(directed) {
+        for (VertexId v = 0; v < numVertices; ++v) {
+            graph_.AddVertex();
+        }
+    }
+
+    bool TryAddEdge(VertexId from, VertexId to) {
+        ReachVisitor visitor(from);
+        std::vector<Color> colors(graph_.NumVertices());
+        Dfs(graph_, to, colors, visitor);
+        if (visitor.reached_) {
+            return false;
+        }
+        graph_.AddEdge(from, to);
+        if (!directed_) {
+            graph_.AddEdge(to, from);
+        }
+        return true;
+    }
+
+private:
+    Graph graph_;
+    bool directed_;
+};
+
+void CheckCycle(
+        const Cycle& cycle,
+        [[maybe_unused]] Graph::VertexId from,
+        [[maybe_unused]] Graph::VertexId to,
+        [[maybe_unused]] const std::vector<std::vector<bool>>& hasEdge,
+        bool directed)
+{
+    assert(!cycle.empty());
+    assert(cycle.front() == from && cycle.back() == to);
+    for (size_t i = 0; i + 1 < cycle.size(); ++i) {
+        assert(hasEdge[cycle[i + 1]][cycle[i]]);
+        if (!directed) {
+            assert(hasEdge[cycle[i]][cycle[i + 1]]);
+        }
+    }
+}
+
+void StressTest() {
+    std::mt19937 gen;
+    for (int test = 0; test < 300; ++test) {
+        bool directed = test % 2;
+        Graph::VertexId numVertices = 1 + gen() % 40;
+        UndirectedCycleDetector undirected(numVertices);
+        DirectedCycleDetector directedDetector(numVertices);
+        NaiveCycleDetector naive(numVertices, directed);
+        std::vector<std::vector<bool>> hasEdge(numVertices, std::vector<bool>(numVertices));
+
+        for (size_t i = 0; i < 3 * numVertices; ++i) {
+            auto from = gen() % numVertices;
+            auto to = gen() % numVertices;
+            auto cycle = directed ? directedDetector.TryAddEdge(from, to) : undirected.TryAddEdge(from, to);
+            bool accepted = from != to && naive.TryAddEdge(from, to);
+            assert(cycle.empty() == accepted);
+            if (accepted) {
+                hasEdge[from][to] = true;
+                if (!directed) {
+                    hasEdge[to][from] = true;
+                }
+            } else {
+                CheckCycle(cycle, from, to, hasEdge, directed);
+            }
+        }
+
+        if (directed) {
+            for (Graph::VertexId from = 0; from < numVertices; ++from) {
+                for (Graph::VertexId to = 0; to < numVertices; ++to) {
+                    assert(!hasEdge[from][to] || directedDetector.GetOrder(from) < directedDetector.GetOrder(to));
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Edges mostly follow a hidden order and join vertices close in it, so most are
+ * accepted and the rest are rejected as they close cycles, like dependencies of
+ * a build arriving one by one. Vertex ids either follow that order (vertices
+ * created before their dependents) or are shuffled, the latter making nearly
+ * every edge disagree with the initial topological order.
+ */
+template <class Detector>
+double StreamSeconds(Detector& detector, Graph::VertexId numVertices, size_t numEdges, bool shuffled, size_t& rejected) {
+    std::mt19937_64 gen(numVertices);
+    std::vector<Graph::VertexId> hidden(numVertices);
+    std::iota(hidden.begin(), hidden.end(), 0);
+    if (shuffled) {
+        std::shuffle(hidden.begin(), hidden.end(), gen);
+    }
+    std::uniform_int_distribution<size_t> position(0, numVertices - 2);
+    std::uniform_int_distribution<size_t> offset(1, 64);
+
+    rejected = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < numEdges; ++i) {
+        auto first = position(gen);
+        auto a = hidden[first];
+        auto b = hidden[std::min(first + offset(gen), numVertices - 1)];
+        if (gen() % 10 == 0) {
+            std::swap(a, b);
+        }
+        auto result = detector.TryAddEdge(a, b);
+        if constexpr (std::is_same_v<decltype(result), bool>) {
+            rejected += !result;
+        } else {
+            rejected += !result.empty();
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+void Benchmark(Graph::VertexId numVertices, size_t numEdges, bool shuffled, bool withNaive) {
+    size_t rejected = 0;
+    for (bool directed : {false, true}) {
+        std::cout << numVertices << " vertices, " << numEdges << (directed ? " directed" : " undirected") <<
+            " insertions, " << (shuffled ? "shuffled ids" : "ids in creation order") << ":";
+        double incremental = 0;
+        if (directed) {
+            DirectedCycleDetector detector(numVertices);
+            incremental = StreamSeconds(detector, numVertices, numEdges, shuffled, rejected);
+        } else {
+            UndirectedCycleDetector detector(numVertices);
+            incremental = StreamSeconds(detector, numVertices, numEdges, shuffled, rejected);
+        }
+        std::cout << " incremental " << incremental * 1e3 << " ms (" << rejected << " rejected)";
+        if (withNaive) {
+            NaiveCycleDetector naive(numVertices, directed);
+            auto seconds = StreamSeconds(naive, numVertices, numEdges, shuffled, rejected);
+            std::cout << ", Dfs per insertion " << seconds * 1e3 << " ms, speedup " << seconds / incremental << "x";
+        }
+        std::cout << '\n';
+    }
+}
+
+/*
+ * Reads "numVertices numEdges" and then 1-based "from to" pairs, adding the edges
+ * one by one, and prints the cycle closed by the first rejected edge like cycle.cpp.
+ */
+template <class Detector>
+void PrintFirstCycle() {
+    Graph::VertexId numVertices;
+    size_t numEdges;
+    std::cin >> numVertices >> numEdges;
+    Detector detector(numVertices);
+    for (size_t i = 0; i < numEdges; ++i) {
+        Graph::VertexId from, to;
+        std::cin >> from >> to;
+        if (auto cycle = detector.TryAddEdge(from - 1, to - 1); !cycle.empty()) {
+            PrintCycle(cycle);
+            return;
+        }
+    }
+    PrintCycle({});
+}
+
+// Usage: 04_08_incremental_cycle [--directed | --undirected], reading edges from stdin;
+// without arguments runs the stress test and the benchmark.
+int main(int argc, char** argv) {
+    std::string_view mode = argc > 1 ? argv[1] : "";
+    if (mode == "--directed") {
+        PrintFirstCycle<DirectedCycleDetector>();
+    } else if (mode == "--undirected") {
+        PrintFirstCycle<UndirectedCycleDetector>();
+    } else {
+        StressTest();
+        Benchmark(2'000, 8'000, false, true);
+        Benchmark(2'000, 8'000, true, true);
+        Benchmark(100'000, 400'000, false, false);
+    }
+}
@@ -0,0 +1,452 @@
+#include "common/stats.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <queue>
+#include <random>
+#include <ranges>
+#include <vector>
+
+class Graph {
+public:
+    using EdgeId = size_t;
+    using VertexId = size_t;
+
+    const auto& GetOutgoingEdges(VertexId vertexId) const {
+        return adjList_[vertexId];
+    }
+
+    const auto& GetEdge(EdgeId edgeId) const {
+        return edges_[edgeId];
+    }
+
+    VertexId NumVertices() const {
+        return adjList_.size();
+    }
+
+    EdgeId NumEdges() const {
+        return edges_.size();
+    }
+
+    size_t MemoryBytes() const {
+        size_t bytes = adjList_.capacity() * sizeof(adjList_[0]) + edges_.capacity() * sizeof(Edge);
+        for (const auto& edgeIds : adjList_) {
+            bytes += edgeIds.capacity() * sizeof(EdgeId);
+        }
+        return bytes;
+    }
+
+protected:
+    void AddEdge(VertexId from, VertexId to) {
+        auto id = edges_.size();
+        edges_.push_back({to});
+        adjList_[from].push_back(id);
+    }
+
+    VertexId AddVertex() {
+        adjList_.emplace_back();
+        return adjList_.size() - 1;
+    }
+
+private:
+    struct Edge {
+        VertexId target;
+    };
+
+    std::vector<std::vector<EdgeId>> adjList_;
+    std::vector<Edge> edges_;
+};
+
+class WeighedGraph : public Graph {
+public:
+    using Weight = int64_t;
+    static constexpr inline Weight INF = std::numeric_limits<Weight>::max();
+
+    struct Arc {
+        EdgeId edgeId;
+        VertexId target;
+        Weight weight;
+    };
+
+    Weight GetWeight(EdgeId edgeId) const {
+        return edgeProperties_[edgeId].weight;
+    }
+
+    auto GetOutgoingArcs(VertexId vertexId) const {
+        return std::views::transform(GetOutgoingEdges(vertexId), [this](EdgeId edgeId) {
+            return Arc{edgeId, GetEdge(edgeId).target, GetWeight(edgeId)};
+        });
+    }
+
+    size_t MemoryBytes() const {
+        return Graph::MemoryBytes() + edgeProperties_.capacity() * sizeof(EdgeProperties);
+    }
+
+private:
+    friend WeighedGraph ReadWeightedUndirectedGraph();
+    friend WeighedGraph RandomWeightedUndirectedGraph(
+        VertexId numVertices, EdgeId numEdges, Weight maxWeight, uint64_t seed);
+
+    void AddEdge(VertexId from, VertexId to, Weight weight) {
+        Graph::AddEdge(from, to);
+        edgeProperties_.push_back({weight});
+    }
+
+    struct EdgeProperties {
+        Weight weight;
+    };
+
+    std::vector<EdgeProperties> edgeProperties_;
+};
+
+WeighedGraph ReadWeightedUndirectedGraph() {
+    WeighedGraph graph;
+    int nv, ne;
+    std::cin >> nv >> ne;
+    for (int i = 0; i < nv; ++i) {
+        graph.AddVertex();
+    }
+    for (int i = 0; i < ne; ++i) {
+        WeighedGraph::VertexId from, to;
+        WeighedGraph::Weight weight;
+        std::cin >> from >> to >> weight;
+        graph.AddEdge(from - 1, to - 1, weight);
+        graph.AddEdge(to - 1, from - 1, weight);
+    }
+    return graph;
+}
+
+WeighedGraph RandomWeightedUndirectedGraph(
+    WeighedGraph::VertexId numVertices,
+    WeighedGraph::EdgeId numEdges,
+    WeighedGraph::Weight maxWeight,
+    uint64_t seed)
+{
+    WeighedGraph graph;
+    for (WeighedGraph::VertexId v = 0; v < numVertices; ++v) {
+        graph.AddVertex();
+    }
+    std::mt19937_64 gen(seed);
+    std::uniform_int_distribution<WeighedGraph::VertexId> vertex(0, numVertices - 1);
+    std::uniform_int_distribution<WeighedGraph::Weight> weight(0, maxWeight);
+    for (WeighedGraph::EdgeId i = 0; i < numEdges; ++i) {
+        auto from = vertex(gen);
+        auto to = vertex(gen);
+        auto w = weight(gen);
+        graph.AddEdge(from, to, w);
+        graph.AddEdge(to, from, w);
+    }
+    return graph;
+}
+
+/*
+ * Weighted compressed sparse rows. Every neighbor list is sorted by target
+ * and stored as LEB128 varints: the target gap (the first one relative to
+ * the vertex itself, zigzag-encoded) followed by the zigzag-encoded weight.
+ * Edge ids are positions in this sorted order, not those of the source graph.
+ */
+class CompressedWeighedGraph {
+public:
+    using EdgeId = WeighedGraph::EdgeId;
+    using VertexId = WeighedGraph::VertexId;
+    using Weight = WeighedGraph::Weight;
+    using Arc = WeighedGraph::Arc;
+
+    class ArcIterator {
+    public:
+        using value_type = Arc;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::input_iterator_tag;
+
+        ArcIterator() = default;
+
+        ArcIterator(const uint8_t* pos, const uint8_t* end, VertexId source, EdgeId firstEdge)
+            : pos_(pos), end_(end), arc_{firstEdge, source, 0}
+        {
+            if (pos_ != end_) {
+                arc_.target += ZigZagDecode(ReadVarint(pos_));
+                arc_.weight = static_cast<Weight>(ZigZagDecode(ReadVarint(pos_)));
+                done_ = false;
+            }
+        }
+
+        const Arc& operator*() const {
+            return arc_;
+        }
+
+        ArcIterator& operator++() {
+            if (pos_ == end_) {
+                done_ = true;
+            } else {
+                ++arc_.edgeId;
+                arc_.target += ReadVarint(pos_);
+                arc_.weight = static_cast<Weight>(ZigZagDecode(ReadVarint(pos_)));
+            }
+            return *this;
+        }
+
+        void operator++(int) {
+            ++*this;
+        }
+
+        bool operator==(std::default_sentinel_t) const {
+            return done_;
+        }
+
+    private:
+        const uint8_t* pos_ = nullptr;
+        const uint8_t* end_ = nullptr;
+        Arc arc_{};
+        bool done_ = true;
+    };
+
+    class ArcRange {
+    public:
+        ArcRange(const uint8_t* begin, const uint8_t* end, VertexId source, EdgeId firstEdge)
+            : begin_(begin), end_(end), source_(source), firstEdge_(firstEdge)
+        {
+        }
+
+        ArcIterator begin() const {
+            return {begin_, end_, source_, firstEdge_};
+        }
+
+        std::default_sentinel_t end() const {
+            return {};
+        }
+
+    private:
+        const uint8_t* begin_;
+        const uint8_t* end_;
+        VertexId source_;
+        EdgeId firstEdge_;
+    };
+
+    explicit CompressedWeighedGraph(const WeighedGraph& graph) : offsets_{0}, firstEdges_{0} {
+        offsets_.reserve(graph.NumVertices() + 1);
+        firstEdges_.reserve(graph.NumVertices() + 1);
+        std::vector<std::pair<VertexId, Weight>> arcs;
+        for (VertexId vertex = 0; vertex < graph.NumVertices(); ++vertex) {
+            arcs.clear();
+            for (auto arc : graph.GetOutgoingArcs(vertex)) {
+                arcs.emplace_back(arc.target, arc.weight);
+            }
+            std::sort(arcs.begin(), arcs.end());
+            auto previous = vertex;
+            for (size_t i = 0; i < arcs.size(); ++i) {
+                auto [target, weight] = arcs[i];
+                WriteVarint(i == 0 ? ZigZagEncode(target - previous) : target - previous);
+                WriteVarint(ZigZagEncode(weight));
+                previous = target;
+            }
+            offsets_.push_back(bytes_.size());
+            firstEdges_.push_back(firstEdges_.back() + arcs.size());
+        }
+        bytes_.shrink_to_fit();
+    }
+
+    ArcRange GetOutgoingArcs(VertexId vertexId) const {
+        return {
+            bytes_.data() + offsets_[vertexId],
+            bytes_.data() + offsets_[vertexId + 1],
+            vertexId,
+            firstEdges_[vertexId]};
+    }
+
+    VertexId NumVertices() const {
+        return offsets_.size() - 1;
+    }
+
+    size_t MemoryBytes() const {
+        return (offsets_.capacity() + firstEdges_.capacity()) * sizeof(size_t) + bytes_.capacity();
+    }
+
+private:
+    static uint64_t ZigZagEncode(uint64_t delta) {
+        auto value = static_cast<int64_t>(delta);
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    static uint64_t ZigZagDecode(uint64_t value) {
+        return (value >> 1) ^ (~(value & 1) + 1);
+    }
+
+    static uint64_t ReadVarint(const uint8_t*& pos) {
+        uint64_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            auto byte = *pos++;
+            value |= uint64_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+    }
+
+    void WriteVarint(uint64_t value) {
+        while (value >= 0x80) {
+            bytes_.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        bytes_.push_back(static_cast<uint8_t>(value));
+    }
+
+    std::vector<size_t> offsets_;
+    std::vector<EdgeId> firstEdges_;
+    std::vector<uint8_t> bytes_;
+};
+
+enum class Color {
+    WHITE,
+    GRAY,
+    BLACK,
+};
+
+/*
+ * https://www.boost.org/doc/libs/1_41_0/libs/graph/doc/dijkstra_shortest_paths.html
+ */
+class DijkstraVisitor {
+public:
+    using VertexId = WeighedGraph::VertexId;
+    using EdgeId = WeighedGraph::EdgeId;
+
+    virtual ~DijkstraVisitor() = default;
+
+    virtual void DiscoverVertex(VertexId) {}
+    virtual void ExamineVertex(VertexId) {}
+    virtual void FinishVertex(VertexId) {}
+
+    virtual void ExamineEdge(EdgeId) {}
+    virtual void EdgeRelaxed(EdgeId) {}
+    virtual void EdgeNotRelaxed(EdgeId) {}
+};
+
+template <class Queue>
+void DecreaseKey(Queue& queue, WeighedGraph::VertexId vertexId, WeighedGraph::Weight distance);
+
+// Works with any graph type whose GetOutgoingArcs returns a range of WeighedGraph::Arc.
+template <class Queue, class AnyGraph>
+auto Dijkstra(
+    const AnyGraph& graph,
+    WeighedGraph::VertexId source,
+    DijkstraVisitor& visitor)
+{
+    STATS_SCOPED_TIMER("dijkstra");
+    std::vector<WeighedGraph::Weight> distances(
+        graph.NumVertices(),
+        std::numeric_limits<WeighedGraph::Weight>::max());
+    distances[source] = 0;
+    std::vector<Color> colors(graph.NumVertices());
+    colors[source] = Color::GRAY;
+    visitor.DiscoverVertex(source);
+    std::vector<WeighedGraph::VertexId> parents(graph.NumVertices(), -1);
+
+    Queue queue;
+    queue.push({distances[source], source});
+
+    while (!queue.empty()) {
+        auto [distance, from] = queue.top();
+        queue.pop();
+        if (colors[from] == Color::BLACK) {
+            STATS_INCREMENT("dijkstra.stale_pops");
+            continue;
+        }
+        visitor.ExamineVertex(from);
+        for (const WeighedGraph::Arc& arc : graph.GetOutgoingArcs(from)) {
+            visitor.ExamineEdge(arc.edgeId);
+            auto to = arc.target;
+            if (arc.weight < WeighedGraph::INF - distance && distances[to] > distance + arc.weight) {
+                distances[to] = distance + arc.weight;
+                parents[to] = from;
+                STATS_INCREMENT("dijkstra.relaxations");
+                visitor.EdgeRelaxed(arc.edgeId);
+                if (colors[to] == Color::WHITE) {
+                    colors[to] = Color::GRAY;
+                    visitor.DiscoverVertex(to);
+                    queue.push({distances[to], to});
+                } else if (colors[to] == Color::GRAY) {
+                    DecreaseKey(queue, to, distances[to]);
+                }
+            } else {
+                 visitor.EdgeNotRelaxed(arc.edgeId);
+            }
+        }
+        STATS_INCREMENT("dijkstra.settled_vertices");
+        visitor.FinishVertex(from);
+        colors[from] = Color::BLACK;
+    }
+    return std::make_pair(distances, parents);
+}
+
+struct HeapElement {
+    WeighedGraph::Weight distance;
+    WeighedGraph::VertexId vertexId;
+
+    auto operator<=>(const HeapElement&) const = default;
+};
+
+using MinHeap = std::priority_queue<HeapElement, std::vector<HeapElement>, std::greater<>>;
+
+template <>
+void DecreaseKey(MinHeap& queue, WeighedGraph::VertexId vertexId, WeighedGraph::Weight distance) {
+    queue.push({distance, vertexId});
+}
+
+void StressTest() {
+    std::mt19937 gen;
+    for (int test = 0; test < 200; ++test) {
+        WeighedGraph::VertexId numVertices = 1 + gen() % 300;
+        auto graph = RandomWeightedUndirectedGraph(numVertices, gen() % (4 * numVertices), WeighedGraph::Weight(1) << (test % 40), test);
+        CompressedWeighedGraph compressed(graph);
+        assert(compressed.NumVertices() == numVertices);
+
+        auto source = gen() % numVertices;
+        DijkstraVisitor visitor;
+        auto [expected, _] = Dijkstra<MinHeap>(graph, source, visitor);
+        auto [distances, parents] = Dijkstra<MinHeap>(compressed, source, visitor);
+        assert(distances == expected);
+        for (WeighedGraph::VertexId vertex = 0; vertex < numVertices; ++vertex) {
+            if (vertex != source && distances[vertex] != WeighedGraph::INF) {
+                [[maybe_unused]] auto arcs = compressed.GetOutgoingArcs(parents[vertex]);
+                assert(std::ranges::any_of(arcs, [&](const WeighedGraph::Arc& arc) {
+                    return arc.target == vertex && distances[parents[vertex]] + arc.weight == distances[vertex];
+                }));
+            }
+        }
+    }
+}
+
+template <class AnyGraph>
+double DijkstraSeconds(const AnyGraph& graph, int numSources) {
+    DijkstraVisitor visitor;
+    auto start = std::chrono::steady_clock::now();
+    for (int source = 0; source < numSources; ++source) {
+        Dijkstra<MinHeap>(graph, source, visitor);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / numSources;
+}
+
+void Benchmark(WeighedGraph::VertexId numVertices, WeighedGraph::EdgeId averageDegree, int numSources = 3) {
+    auto graph = RandomWeightedUndirectedGraph(numVertices, numVertices * averageDegree / 2, 1000, 1);
+    CompressedWeighedGraph compressed(graph);
+
+    auto numEdges = double(graph.NumEdges());
+    auto baseline = DijkstraSeconds(graph, numSources);
+    auto seconds = DijkstraSeconds(compressed, numSources);
+    std::cout << numVertices << " vertices, " << graph.NumEdges() << " arcs\n";
+    std::cout << "  WeighedGraph: " << graph.MemoryBytes() / numEdges << " bytes/edge, Dijkstra " <<
+        baseline * 1e3 << " ms\n";
+    std::cout << "  CompressedWeighedGraph: " << compressed.MemoryBytes() / numEdges <<
+        " bytes/edge, Dijkstra " << seconds * 1e3 << " ms (" << seconds / baseline << "x)\n";
+}
+
+int main() {
+    StressTest();
+    Benchmark(1 << 18, 16);
+    STATS_DUMP_JSON(std::cerr);
+}
@@ -1,9 +1,40 @@
+#include "common/stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <numeric>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include <queue>
 #include <set>
 
+#include <poll.h>
+#include <pthread.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
 class Graph {
 public:
     using EdgeId = size_t;
@@ -126,6 +157,7 @@ auto Dijkstra(
     WeighedGraph::VertexId source,
     DijkstraVisitor& visitor)
 {
+    STATS_SCOPED_TIMER("dijkstra");
     std::vector<WeighedGraph::Weight> distances(
         graph.NumVertices(),
         std::numeric_limits<WeighedGraph::Weight>::max());
@@ -142,6 +174,7 @@ auto Dijkstra(
         auto [distance, from] = queue.top();
         queue.pop();
         if (colors[from] == Color::BLACK) {
+            STATS_INCREMENT("dijkstra.stale_pops");
             continue;
         }
         visitor.ExamineVertex(source);
@@ -152,6 +185,7 @@ auto Dijkstra(
                     distances[to] > distance + graph.GetWeight(edgeId)) {
                 distances[to] = distance + graph.GetWeight(edgeId);
                 parents[to] = from;
+                STATS_INCREMENT("dijkstra.relaxations");
                 visitor.EdgeRelaxed(edgeId);
                 if (colors[to] == Color::WHITE) {
                     colors[to] = Color::GRAY;
@@ -165,6 +199,7 @@ auto Dijkstra(
                  visitor.EdgeNotRelaxed(edgeId);
             }
         }
+        STATS_INCREMENT("dijkstra.settled_vertices");
         visitor.FinishVertex(from);
         colors[from] = Color::BLACK;
     }
@@ -185,7 +220,501 @@ void DecreaseKey(MinHeap& queue, WeighedGraph::VertexId vertexId, WeighedGraph::
     queue.push({distance, vertexId});
 }
 
-int main() {
+class WorkerPool {
+public:
+    explicit WorkerPool(size_t numThreads) {
+        for (size_t i = 0; i < numThreads; ++i) {
+            threads_.emplace_back([this] {
+                Work();
+            });
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard lock(mutex_);
+            stopping_ = true;
+        }
+        hasTasks_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    void Submit(std::function<void()> task) {
+        {
+            std::lock_guard lock(mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        hasTasks_.notify_one();
+    }
+
+private:
+    void Work() {
+        std::unique_lock lock(mutex_);
+        while (true) {
+            hasTasks_.wait(lock, [this] {
+                return stopping_ || !tasks_.empty();
+            });
+            if (tasks_.empty()) {
+                return;
+            }
+            auto task = std::move(tasks_.front());
+            tasks_.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable hasTasks_;
+    std::deque<std::function<void()>> tasks_;
+    bool stopping_ = false;
+    std::vector<std::thread> threads_;
+};
+
+/*
+ * LRU cache of Dijkstra distances by source. Entries are shared, so one
+ * evicted while a worker still reads it lives until that worker is done.
+ * Concurrent misses on one source run a single computation, the others wait for it.
+ */
+class ShortestPathCache {
+public:
+    using Distances = std::shared_ptr<const std::vector<WeighedGraph::Weight>>;
+
+    explicit ShortestPathCache(size_t capacity) : capacity_(capacity) {
+    }
+
+    // Distances from `source`; `compute()` runs only if they are neither cached nor being computed.
+    template <class Compute>
+    Distances Get(WeighedGraph::VertexId source, Compute compute, bool& computed) {
+        std::unique_lock lock(mutex_);
+        computed = false;
+        if (auto it = positions_.find(source); it != positions_.end()) {
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return it->second->second;
+        }
+        if (auto it = inFlight_.find(source); it != inFlight_.end()) {
+            auto pending = it->second;
+            lock.unlock();
+            return pending.get();
+        }
+
+        std::promise<Distances> promise;
+        inFlight_.emplace(source, promise.get_future().share());
+        lock.unlock();
+
+        Distances entry;
+        try {
+            entry = std::make_shared<const std::vector<WeighedGraph::Weight>>(compute());
+        } catch (...) {
+            promise.set_exception(std::current_exception());
+            lock.lock();
+            inFlight_.erase(source);
+            throw;
+        }
+        computed = true;
+
+        lock.lock();
+        inFlight_.erase(source);
+        if (capacity_ > 0) {
+            entries_.emplace_front(source, entry);
+            positions_[source] = entries_.begin();
+            if (entries_.size() > capacity_) {
+                positions_.erase(entries_.back().first);
+                entries_.pop_back();
+            }
+        }
+        lock.unlock();
+        promise.set_value(entry);
+        return entry;
+    }
+
+private:
+    size_t capacity_;
+    std::mutex mutex_;
+    std::list<std::pair<WeighedGraph::VertexId, Distances>> entries_;
+    std::unordered_map<WeighedGraph::VertexId, decltype(entries_)::iterator> positions_;
+    std::unordered_map<WeighedGraph::VertexId, std::shared_future<Distances>> inFlight_;
+};
+
+struct ServeReport {
+    std::vector<double> latencies;  // microseconds from reading a query to writing its answer
+    size_t cacheHits = 0;
+    double seconds = 0;
+
+    void Print(std::ostream& out) const {
+        std::ostringstream report;
+        report << "served " << latencies.size() << " queries in " << seconds << " s";
+        if (!latencies.empty()) {
+            auto sorted = latencies;
+            std::sort(sorted.begin(), sorted.end());
+            report << ": " << static_cast<size_t>(sorted.size() / seconds) << " queries/s" <<
+                ", latency p50 " << sorted[sorted.size() / 2] << " us" <<
+                ", p99 " << sorted[sorted.size() * 99 / 100] << " us" <<
+                ", cache hits " << 100.0 * cacheHits / sorted.size() << "%";
+        }
+        out << report.str() << std::endl;
+    }
+};
+
+/*
+ * Answers a stream of "source target" lines, one distance (or -1) per line in
+ * the same order. Queries are cut into batches of whatever has already arrived
+ * (at most MAX_BATCH_SIZE), batches are answered concurrently on the pool and
+ * each batch is written with a single write as soon as all earlier ones are.
+ */
+class QueryServer {
+public:
+    static constexpr inline size_t MAX_BATCH_SIZE = 256;
+    static constexpr inline size_t MAX_PENDING_BATCHES = 64;
+
+    QueryServer(const WeighedGraph& graph, size_t numThreads, size_t cacheBytes)
+        : graph_(graph),
+          cache_(cacheBytes / (std::max<size_t>(graph.NumVertices(), 1) * sizeof(WeighedGraph::Weight))),
+          pool_(numThreads)
+    {
+    }
+
+    ServeReport Serve(std::istream& in, std::ostream& out) {
+        ServeReport report;
+        Connection connection;
+        auto start = std::chrono::steady_clock::now();
+
+        std::thread writer([&] {
+            std::unique_lock lock(connection.mutex);
+            while (true) {
+                connection.changed.wait(lock, [&] {
+                    return (connection.finished && connection.pending.empty()) ||
+                        (!connection.pending.empty() && connection.pending.front()->done);
+                });
+                if (connection.pending.empty()) {
+                    return;
+                }
+                auto batch = std::move(connection.pending.front());
+                connection.pending.pop_front();
+                connection.changed.notify_all();
+                lock.unlock();
+
+                out.write(batch->output.data(), batch->output.size());
+                out.flush();
+                auto written = std::chrono::steady_clock::now();
+                for (auto arrival : batch->arrivals) {
+                    report.latencies.push_back(std::chrono::duration<double, std::micro>(written - arrival).count());
+                }
+                report.cacheHits += batch->cacheHits;
+                lock.lock();
+            }
+        });
+
+        auto batch = std::make_shared<QueryBatch>();
+        WeighedGraph::VertexId source, target;
+        while (in >> source >> target) {
+            batch->queries.emplace_back(source - 1, target - 1);
+            batch->arrivals.push_back(std::chrono::steady_clock::now());
+            auto* buffer = in.rdbuf();
+            while (buffer->in_avail() > 0 && std::isspace(buffer->sgetc())) {
+                buffer->sbumpc();
+            }
+            if (batch->queries.size() == MAX_BATCH_SIZE || buffer->in_avail() <= 0) {
+                Submit(connection, std::exchange(batch, std::make_shared<QueryBatch>()));
+            }
+        }
+        if (!batch->queries.empty()) {
+            Submit(connection, std::move(batch));
+        }
+        {
+            std::lock_guard lock(connection.mutex);
+            connection.finished = true;
+        }
+        connection.changed.notify_all();
+        writer.join();
+
+        report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return report;
+    }
+
+private:
+    struct QueryBatch {
+        std::vector<std::pair<WeighedGraph::VertexId, WeighedGraph::VertexId>> queries;
+        std::vector<std::chrono::steady_clock::time_point> arrivals;
+        std::string output;
+        size_t cacheHits = 0;
+        bool done = false;
+    };
+
+    struct Connection {
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<std::shared_ptr<QueryBatch>> pending;
+        bool finished = false;
+    };
+
+    void Submit(Connection& connection, std::shared_ptr<QueryBatch> batch) {
+        {
+            std::unique_lock lock(connection.mutex);
+            connection.changed.wait(lock, [&] {
+                return connection.pending.size() < MAX_PENDING_BATCHES;
+            });
+            connection.pending.push_back(batch);
+        }
+        pool_.Submit([this, &connection, batch] {
+            for (auto [source, target] : batch->queries) {
+                batch->output += std::to_string(Answer(source, target, batch->cacheHits));
+                batch->output += '\n';
+            }
+            // Notify under the lock: once it is released the writer may finish and destroy `connection`.
+            std::lock_guard lock(connection.mutex);
+            batch->done = true;
+            connection.changed.notify_all();
+        });
+    }
+
+    WeighedGraph::Weight Answer(WeighedGraph::VertexId source, WeighedGraph::VertexId target, size_t& cacheHits) {
+        if (source >= graph_.NumVertices() || target >= graph_.NumVertices()) {
+            return -1;
+        }
+        bool computed = false;
+        auto distances = cache_.Get(source, [&] {
+            DijkstraVisitor visitor;
+            return Dijkstra<MinHeap>(graph_, source, visitor).first;
+        }, computed);
+        cacheHits += !computed;
+        auto weight = (*distances)[target];
+        return weight == WeighedGraph::INF ? -1 : weight;
+    }
+
+    const WeighedGraph& graph_;
+    ShortestPathCache cache_;
+    WorkerPool pool_;
+};
+
+// Reads and writes a socket; the descriptor stays owned (and is closed) by the caller.
+class FdStreamBuf : public std::streambuf {
+public:
+    explicit FdStreamBuf(int fd) : fd_(fd) {
+        setg(buffer_, buffer_, buffer_);
+    }
+
+protected:
+    int_type underflow() override {
+        ssize_t size;
+        do {
+            size = read(fd_, buffer_, sizeof(buffer_));
+        } while (size < 0 && errno == EINTR);
+        if (size <= 0) {
+            return traits_type::eof();
+        }
+        setg(buffer_, buffer_, buffer_ + size);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    std::streamsize xsputn(const char* data, std::streamsize size) override {
+        std::streamsize written = 0;
+        while (written < size) {
+            auto result = send(fd_, data + written, size - written, MSG_NOSIGNAL);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                break;
+            }
+            written += result;
+        }
+        return written;
+    }
+
+    int_type overflow(int_type ch) override {
+        if (traits_type::eq_int_type(ch, traits_type::eof())) {
+            return traits_type::not_eof(ch);
+        }
+        char symbol = traits_type::to_char_type(ch);
+        return xsputn(&symbol, 1) == 1 ? ch : traits_type::eof();
+    }
+
+private:
+    int fd_;
+    char buffer_[1 << 16];
+};
+
+// SIGINT and SIGTERM stop the socket server; they are blocked in every thread and read from a signalfd.
+sigset_t ShutdownSignals() {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    return signals;
+}
+
+/*
+ * Accepts clients until SIGINT or SIGTERM (returns 0) or an error (returns 1).
+ * Then stops reading from the clients, lets them write the answers to what
+ * they have already sent, and removes the socket file.
+ */
+int ServeUnixSocket(QueryServer& server, const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "socket path is too long: " << path << std::endl;
+        return 1;
+    }
+    std::copy(path.begin(), path.end(), address.sun_path);
+
+    // Only a socket left over by an earlier run may be replaced.
+    struct stat existing;
+    if (lstat(path.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            std::cerr << path << " exists and is not a socket" << std::endl;
+            return 1;
+        }
+        unlink(path.c_str());
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+            listen(listener, SOMAXCONN) < 0) {
+        std::perror(path.c_str());
+        if (listener >= 0) {
+            close(listener);
+        }
+        return 1;
+    }
+    auto signals = ShutdownSignals();
+    int signalFd = signalfd(-1, &signals, SFD_CLOEXEC);
+    if (signalFd < 0) {
+        std::perror("signalfd");
+        close(listener);
+        unlink(path.c_str());
+        return 1;
+    }
+    std::cerr << "listening on " << path << std::endl;
+
+    // Client threads stay joinable, so `server` outlives them; finished ones are joined on every accept.
+    struct Client {
+        int fd = -1;
+        std::thread thread;
+        std::atomic<bool> finished = false;
+    };
+    std::list<Client> clients;
+    int status = 0;
+    pollfd polled[] = {{listener, POLLIN, 0}, {signalFd, POLLIN, 0}};
+    while (true) {
+        if (poll(polled, std::size(polled), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::perror("poll");
+            status = 1;
+            break;
+        }
+        if (polled[1].revents & POLLIN) {
+            std::cerr << "shutting down" << std::endl;
+            break;
+        }
+        if (!(polled[0].revents & POLLIN)) {
+            continue;
+        }
+        int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            std::perror("accept");
+            status = 1;
+            break;
+        }
+        for (auto it = clients.begin(); it != clients.end();) {
+            if (it->finished) {
+                it->thread.join();
+                close(it->fd);
+                it = clients.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        auto& client = clients.emplace_back();
+        client.fd = fd;
+        client.thread = std::thread([&server, &client] {
+            FdStreamBuf buffer(client.fd);
+            // Separate streams: reaching the end of the input must not fail the output.
+            std::istream input(&buffer);
+            std::ostream output(&buffer);
+            server.Serve(input, output).Print(std::cerr);
+            // Lets the client see the end of the answers; the fd itself is closed once the thread is joined.
+            shutdown(client.fd, SHUT_RDWR);
+            client.finished = true;
+        });
+    }
+
+    close(signalFd);
+    close(listener);
+    unlink(path.c_str());
+    for (auto& client : clients) {
+        // Ends the client's query stream; its fd stays open until the thread is joined.
+        shutdown(client.fd, SHUT_RD);
+    }
+    for (auto& client : clients) {
+        client.thread.join();
+        close(client.fd);
+    }
+    return status;
+}
+
+/*
+ * 04_22_dijkstra --serve [--threads N] [--cache-mb MB] [--socket PATH]
+ *
+ * Reads the graph from stdin once, then answers "source target" queries from
+ * the rest of stdin, or from every client connecting to the Unix socket PATH
+ * until SIGINT or SIGTERM. Latency percentiles and throughput go to stderr
+ * when a stream ends.
+ */
+int Serve(const std::vector<std::string_view>& args) {
+    size_t numThreads = std::max(1u, std::thread::hardware_concurrency());
+    size_t cacheMegabytes = 256;
+    std::string socketPath;
+    for (size_t i = 2; i < args.size(); ++i) {
+        if (i + 1 < args.size() && args[i] == "--threads") {
+            numThreads = std::max<size_t>(1, std::stoull(std::string(args[++i])));
+        } else if (i + 1 < args.size() && args[i] == "--cache-mb") {
+            cacheMegabytes = std::stoull(std::string(args[++i]));
+        } else if (i + 1 < args.size() && args[i] == "--socket") {
+            socketPath = args[++i];
+        } else {
+            std::cerr << "usage: --serve [--threads N] [--cache-mb MB] [--socket PATH]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (!socketPath.empty()) {
+        // Before any thread starts, so that all of them inherit the mask.
+        auto signals = ShutdownSignals();
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    }
+
+    std::cin.tie(nullptr);
+    std::ios_base::sync_with_stdio(false);
+
+    auto graph = ReadWeightedUndirectedGraph();
+    int status = 0;
+    {
+        QueryServer server(graph, numThreads, cacheMegabytes << 20);
+        if (socketPath.empty()) {
+            server.Serve(std::cin, std::cout).Print(std::cerr);
+        } else {
+            status = ServeUnixSocket(server, socketPath);
+        }
+    }
+    STATS_DUMP_JSON(std::cerr);
+    return status;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string_view> args(argv, argv + argc);
+    if (args.size() > 1 && args[1] == "--serve") {
+        return Serve(args);
+    }
+
 //    std::cin.tie(nullptr);
 //    std::ios_base::sync_with_stdio(false);
 
@@ -195,11 +724,16 @@ int main() {
     std::cin >> source >> target;
 
     DijkstraVisitor visitor;
-    auto[distances, _] = Dijkstra<MinHeap>(graph, source - 1, visitor);
+    std::vector<WeighedGraph::Weight> distances;
+    {
+        STATS_SCOPED_PERF("dijkstra");
+        distances = Dijkstra<MinHeap>(graph, source - 1, visitor).first;
+    }
 
     auto weight = distances[target - 1];
     if (weight == WeighedGraph::INF) {
         weight = -1;
     }
     std::cout << weight << std::endl;
+    STATS_DUMP_JSON(std::cerr);
 }
@@ -0,0 +1,515 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <queue>
+#include <random>
+#include <tuple>
+#include <vector>
+
+/*
+ * Directed weighted graph that can change after it is built: edges can be
+ * added, removed and reweighted. Edge ids stay valid until the edge is removed.
+ * An undirected edge is two arcs, as in ReadWeightedUndirectedGraph.
+ */
+class MutableWeighedGraph {
+public:
+    using EdgeId = size_t;
+    using VertexId = size_t;
+    using Weight = int64_t;
+    static constexpr inline Weight INF = std::numeric_limits<Weight>::max();
+
+    struct Edge {
+        VertexId source;
+        VertexId target;
+    };
+
+    explicit MutableWeighedGraph(VertexId numVertices = 0)
+        : outgoing_(numVertices), incoming_(numVertices)
+    {
+    }
+
+    const auto& GetOutgoingEdges(VertexId vertexId) const {
+        return outgoing_[vertexId];
+    }
+
+    const auto& GetIncomingEdges(VertexId vertexId) const {
+        return incoming_[vertexId];
+    }
+
+    const Edge& GetEdge(EdgeId edgeId) const {
+        return edges_[edgeId];
+    }
+
+    Weight GetWeight(EdgeId edgeId) const {
+        return weights_[edgeId];
+    }
+
+    VertexId NumVertices() const {
+        return outgoing_.size();
+    }
+
+    VertexId AddVertex() {
+        outgoing_.emplace_back();
+        incoming_.emplace_back();
+        return outgoing_.size() - 1;
+    }
+
+    EdgeId AddEdge(VertexId from, VertexId to, Weight weight) {
+        assert(weight >= 0);
+        auto id = edges_.size();
+        edges_.push_back({from, to});
+        weights_.push_back(weight);
+        outgoing_[from].push_back(id);
+        incoming_[to].push_back(id);
+        return id;
+    }
+
+    void RemoveEdge(EdgeId edgeId) {
+        auto [from, to] = edges_[edgeId];
+        [[maybe_unused]] auto removed = std::erase(outgoing_[from], edgeId) + std::erase(incoming_[to], edgeId);
+        assert(removed == 2);
+        weights_[edgeId] = INF;
+    }
+
+    void SetWeight(EdgeId edgeId, Weight weight) {
+        assert(weight >= 0);
+        weights_[edgeId] = weight;
+    }
+
+private:
+    std::vector<std::vector<EdgeId>> outgoing_;
+    std::vector<std::vector<EdgeId>> incoming_;
+    std::vector<Edge> edges_;
+    std::vector<Weight> weights_;
+};
+
+enum class Color {
+    WHITE,
+    GRAY,
+    BLACK,
+};
+
+/*
+ * https://www.boost.org/doc/libs/1_41_0/libs/graph/doc/dijkstra_shortest_paths.html
+ */
+class DijkstraVisitor {
+public:
+    using VertexId = MutableWeighedGraph::VertexId;
+    using EdgeId = MutableWeighedGraph::EdgeId;
+
+    virtual ~DijkstraVisitor() = default;
+
+    virtual void DiscoverVertex(VertexId) {}
+    virtual void ExamineVertex(VertexId) {}
+    virtual void FinishVertex(VertexId) {}
+
+    virtual void ExamineEdge(EdgeId) {}
+    virtual void EdgeRelaxed(EdgeId) {}
+    virtual void EdgeNotRelaxed(EdgeId) {}
+};
+
+template <class Queue>
+void DecreaseKey(Queue& queue, MutableWeighedGraph::VertexId vertexId, MutableWeighedGraph::Weight distance);
+
+template <class Queue>
+auto Dijkstra(
+    const MutableWeighedGraph& graph,
+    MutableWeighedGraph::VertexId source,
+    DijkstraVisitor& visitor)
+{
+    std::vector<MutableWeighedGraph::Weight> distances(graph.NumVertices(), MutableWeighedGraph::INF);
+    distances[source] = 0;
+    std::vector<Color> colors(graph.NumVertices());
+    colors[source] = Color::GRAY;
+    visitor.DiscoverVertex(source);
+    std::vector<MutableWeighedGraph::VertexId> parents(graph.NumVertices(), -1);
+
+    Queue queue;
+    queue.push({distances[source], source});
+
+    while (!queue.empty()) {
+        auto [distance, from] = queue.top();
+        queue.pop();
+        if (colors[from] == Color::BLACK) {
+            continue;
+        }
+        visitor.ExamineVertex(from);
+        for (auto edgeId : graph.GetOutgoingEdges(from)) {
+            visitor.ExamineEdge(edgeId);
+            auto to = graph.GetEdge(edgeId).target;
+            if (graph.GetWeight(edgeId) < MutableWeighedGraph::INF - distance &&
+                    distances[to] > distance + graph.GetWeight(edgeId)) {
+                distances[to] = distance + graph.GetWeight(edgeId);
+                parents[to] = from;
+                visitor.EdgeRelaxed(edgeId);
+                if (colors[to] == Color::WHITE) {
+                    colors[to] = Color::GRAY;
+                    visitor.DiscoverVertex(to);
+                    queue.push({distances[to], to});
+                } else if (colors[to] == Color::GRAY) {
+                    DecreaseKey(queue, to, distances[to]);
+                }
+            } else {
+                 visitor.EdgeNotRelaxed(edgeId);
+            }
+        }
+        visitor.FinishVertex(from);
+        colors[from] = Color::BLACK;
+    }
+    return std::make_pair(distances, parents);
+}
+
+struct HeapElement {
+    MutableWeighedGraph::Weight distance;
+    MutableWeighedGraph::VertexId vertexId;
+
+    auto operator<=>(const HeapElement&) const = default;
+};
+
+using MinHeap = std::priority_queue<HeapElement, std::vector<HeapElement>, std::greater<>>;
+
+template <>
+void DecreaseKey(MinHeap& queue, MutableWeighedGraph::VertexId vertexId, MutableWeighedGraph::Weight distance) {
+    queue.push({distance, vertexId});
+}
+
+/*
+ * Single-source shortest paths kept up to date under edge updates, in the
+ * spirit of G. Ramalingam, T. Reps, "An incremental algorithm for a
+ * generalization of the shortest-path problem" (1996).
+ *
+ * All updates go through this class so it sees the old and new weights:
+ *  - an edge that got cheaper (or appeared) can only shorten paths, so a
+ *    Dijkstra pass starts from its target and stops where nothing improves;
+ *  - an edge that got more expensive (or disappeared) matters only if it is
+ *    in the shortest-path tree. Then only the subtree below it is affected:
+ *    those vertices are re-seeded from their unaffected in-neighbors and
+ *    settled with a Dijkstra pass restricted to the subtree.
+ *
+ * Either way the work is proportional to the affected vertices and their edges.
+ */
+class DynamicShortestPaths {
+public:
+    using VertexId = MutableWeighedGraph::VertexId;
+    using EdgeId = MutableWeighedGraph::EdgeId;
+    using Weight = MutableWeighedGraph::Weight;
+    static constexpr inline EdgeId NO_EDGE = -1;
+
+    DynamicShortestPaths(MutableWeighedGraph& graph, VertexId source)
+        : graph_(graph), source_(source), parentEdges_(graph.NumVertices(), NO_EDGE)
+    {
+        DijkstraVisitor visitor;
+        std::tie(distances_, parents_) = Dijkstra<MinHeap>(graph_, source_, visitor);
+        for (VertexId vertex = 0; vertex < graph_.NumVertices(); ++vertex) {
+            if (vertex != source_ && distances_[vertex] != INF) {
+                parentEdges_[vertex] = FindParentEdge(vertex);
+            }
+        }
+    }
+
+    const std::vector<Weight>& GetDistances() const {
+        return distances_;
+    }
+
+    const std::vector<VertexId>& GetParents() const {
+        return parents_;
+    }
+
+    // Vertices whose distance or parent had to be recomputed by the last update.
+    size_t NumTouched() const {
+        return numTouched_;
+    }
+
+    EdgeId AddEdge(VertexId from, VertexId to, Weight weight) {
+        auto edgeId = graph_.AddEdge(from, to, weight);
+        Improve(edgeId);
+        return edgeId;
+    }
+
+    void RemoveEdge(EdgeId edgeId) {
+        auto to = graph_.GetEdge(edgeId).target;
+        graph_.RemoveEdge(edgeId);
+        numTouched_ = 0;
+        if (parentEdges_[to] == edgeId) {
+            Reroute(to);
+        }
+    }
+
+    void SetWeight(EdgeId edgeId, Weight weight) {
+        auto oldWeight = graph_.GetWeight(edgeId);
+        graph_.SetWeight(edgeId, weight);
+        numTouched_ = 0;
+        if (weight < oldWeight) {
+            Improve(edgeId);
+        } else if (weight > oldWeight && parentEdges_[graph_.GetEdge(edgeId).target] == edgeId) {
+            Reroute(graph_.GetEdge(edgeId).target);
+        }
+    }
+
+private:
+    static constexpr inline Weight INF = MutableWeighedGraph::INF;
+
+    Weight DistanceVia(EdgeId edgeId) const {
+        auto from = graph_.GetEdge(edgeId).source;
+        auto weight = graph_.GetWeight(edgeId);
+        if (distances_[from] == INF || weight >= INF - distances_[from]) {
+            return INF;
+        }
+        return distances_[from] + weight;
+    }
+
+    EdgeId FindParentEdge(VertexId vertex) const {
+        for (auto edgeId : graph_.GetIncomingEdges(vertex)) {
+            if (graph_.GetEdge(edgeId).source == parents_[vertex] && DistanceVia(edgeId) == distances_[vertex]) {
+                return edgeId;
+            }
+        }
+        assert(false);
+        return NO_EDGE;
+    }
+
+    void SetParent(VertexId vertex, EdgeId edgeId, Weight distance) {
+        distances_[vertex] = distance;
+        parentEdges_[vertex] = edgeId;
+        parents_[vertex] = edgeId == NO_EDGE ? VertexId(-1) : graph_.GetEdge(edgeId).source;
+        ++numTouched_;
+    }
+
+    // `edgeId` got cheaper or appeared: propagate shorter distances from its target.
+    void Improve(EdgeId edgeId) {
+        numTouched_ = 0;
+        auto to = graph_.GetEdge(edgeId).target;
+        auto distance = DistanceVia(edgeId);
+        if (distance >= distances_[to]) {
+            return;
+        }
+        SetParent(to, edgeId, distance);
+
+        MinHeap queue;
+        queue.push({distance, to});
+        while (!queue.empty()) {
+            auto [distance, from] = queue.top();
+            queue.pop();
+            if (distance != distances_[from]) {
+                continue;
+            }
+            for (auto outgoing : graph_.GetOutgoingEdges(from)) {
+                auto next = graph_.GetEdge(outgoing).target;
+                auto candidate = DistanceVia(outgoing);
+                if (candidate < distances_[next]) {
+                    SetParent(next, outgoing, candidate);
+                    queue.push({candidate, next});
+                }
+            }
+        }
+    }
+
+    // The tree edge into `root` got more expensive or disappeared: recompute its subtree.
+    void Reroute(VertexId root) {
+        std::vector<VertexId> affected{root};
+        ++mark_;
+        if (marks_.size() < graph_.NumVertices()) {
+            marks_.resize(graph_.NumVertices());
+        }
+        marks_[root] = mark_;
+        for (size_t i = 0; i < affected.size(); ++i) {
+            for (auto edgeId : graph_.GetOutgoingEdges(affected[i])) {
+                auto child = graph_.GetEdge(edgeId).target;
+                if (parentEdges_[child] == edgeId && marks_[child] != mark_) {
+                    marks_[child] = mark_;
+                    affected.push_back(child);
+                }
+            }
+        }
+
+        for (auto vertex : affected) {
+            distances_[vertex] = INF;
+        }
+        MinHeap queue;
+        for (auto vertex : affected) {
+            auto best = INF;
+            auto bestEdge = NO_EDGE;
+            for (auto edgeId : graph_.GetIncomingEdges(vertex)) {
+                if (marks_[graph_.GetEdge(edgeId).source] == mark_) {
+                    continue;
+                }
+                auto candidate = DistanceVia(edgeId);
+                if (candidate < best) {
+                    best = candidate;
+                    bestEdge = edgeId;
+                }
+            }
+            SetParent(vertex, bestEdge, best);
+            if (best != INF) {
+                queue.push({best, vertex});
+            }
+        }
+
+        while (!queue.empty()) {
+            auto [distance, from] = queue.top();
+            queue.pop();
+            if (distance != distances_[from]) {
+                continue;
+            }
+            for (auto edgeId : graph_.GetOutgoingEdges(from)) {
+                auto next = graph_.GetEdge(edgeId).target;
+                if (marks_[next] != mark_) {
+                    continue;
+                }
+                auto candidate = DistanceVia(edgeId);
+                if (candidate < distances_[next]) {
+                    SetParent(next, edgeId, candidate);
+                    queue.push({candidate, next});
+                }
+            }
+        }
+    }
+
+    MutableWeighedGraph& graph_;
+    VertexId source_;
+    std::vector<Weight> distances_;
+    std::vector<VertexId> parents_;
+    std::vector<EdgeId> parentEdges_;
+    size_t numTouched_ = 0;
+
+    // marks_[v] == mark_ iff v is in the subtree being rerouted.
+    std::vector<uint64_t> marks_;
+    uint64_t mark_ = 0;
+};
+
+class RandomUpdates {
+public:
+    RandomUpdates(MutableWeighedGraph::VertexId numVertices, MutableWeighedGraph::Weight maxWeight, uint64_t seed)
+        : gen_(seed), vertex_(0, numVertices - 1), weight_(0, maxWeight)
+    {
+    }
+
+    // Adds a random edge, removes a random live edge or changes its weight, with equal chances.
+    void Apply(DynamicShortestPaths& paths) {
+        auto kind = gen_() % 3;
+        if (kind == 0 || live_.empty()) {
+            live_.push_back(paths.AddEdge(vertex_(gen_), vertex_(gen_), weight_(gen_)));
+            return;
+        }
+        auto index = gen_() % live_.size();
+        auto edgeId = live_[index];
+        if (kind == 1) {
+            paths.RemoveEdge(edgeId);
+            live_[index] = live_.back();
+            live_.pop_back();
+        } else {
+            paths.SetWeight(edgeId, weight_(gen_));
+        }
+    }
+
+    void Track(MutableWeighedGraph::EdgeId edgeId) {
+        live_.push_back(edgeId);
+    }
+
+private:
+    std::mt19937_64 gen_;
+    std::uniform_int_distribution<MutableWeighedGraph::VertexId> vertex_;
+    std::uniform_int_distribution<MutableWeighedGraph::Weight> weight_;
+    std::vector<MutableWeighedGraph::EdgeId> live_;
+};
+
+MutableWeighedGraph RandomGraph(
+    MutableWeighedGraph::VertexId numVertices,
+    MutableWeighedGraph::EdgeId numEdges,
+    MutableWeighedGraph::Weight maxWeight,
+    uint64_t seed)
+{
+    MutableWeighedGraph graph(numVertices);
+    std::mt19937_64 gen(seed);
+    std::uniform_int_distribution<MutableWeighedGraph::VertexId> vertex(0, numVertices - 1);
+    std::uniform_int_distribution<MutableWeighedGraph::Weight> weight(0, maxWeight);
+    for (MutableWeighedGraph::EdgeId i = 0; i < numEdges; ++i) {
+        graph.AddEdge(vertex(gen), vertex(gen), weight(gen));
+    }
+    return graph;
+}
+
+void CheckAgainstDijkstra(const MutableWeighedGraph& graph, const DynamicShortestPaths& paths, size_t source) {
+    DijkstraVisitor visitor;
+    auto [expected, _] = Dijkstra<MinHeap>(graph, source, visitor);
+    const auto& distances = paths.GetDistances();
+    const auto& parents = paths.GetParents();
+    assert(distances == expected);
+    for (size_t vertex = 0; vertex < graph.NumVertices(); ++vertex) {
+        if (vertex == source || distances[vertex] == MutableWeighedGraph::INF) {
+            continue;
+        }
+        auto edges = graph.GetOutgoingEdges(parents[vertex]);
+        assert(std::any_of(edges.begin(), edges.end(), [&](size_t edgeId) {
+            return graph.GetEdge(edgeId).target == vertex &&
+                distances[parents[vertex]] + graph.GetWeight(edgeId) == distances[vertex];
+        }));
+    }
+}
+
+void StressTest() {
+    std::mt19937 gen;
+    for (int test = 0; test < 100; ++test) {
+        MutableWeighedGraph::VertexId numVertices = 1 + gen() % 50;
+        auto graph = RandomGraph(numVertices, gen() % (3 * numVertices), test % 2 ? 10 : 0, test);
+        auto source = gen() % numVertices;
+        DynamicShortestPaths paths(graph, source);
+        RandomUpdates updates(numVertices, test % 2 ? 10 : 1, test);
+        for (MutableWeighedGraph::VertexId vertex = 0; vertex < numVertices; ++vertex) {
+            for (auto edgeId : graph.GetOutgoingEdges(vertex)) {
+                updates.Track(edgeId);
+            }
+        }
+        for (int i = 0; i < 200; ++i) {
+            updates.Apply(paths);
+            CheckAgainstDijkstra(graph, paths, source);
+        }
+    }
+}
+
+/*
+ * Applies a random stream of insertions, deletions and weight changes and compares
+ * the incremental repair with rerunning Dijkstra after every update.
+ */
+void Benchmark(MutableWeighedGraph::VertexId numVertices, MutableWeighedGraph::EdgeId averageDegree, int numUpdates) {
+    auto graph = RandomGraph(numVertices, numVertices * averageDegree, 1000, 1);
+    DynamicShortestPaths paths(graph, 0);
+    RandomUpdates updates(numVertices, 1000, 2);
+    for (MutableWeighedGraph::VertexId vertex = 0; vertex < numVertices; ++vertex) {
+        for (auto edgeId : graph.GetOutgoingEdges(vertex)) {
+            updates.Track(edgeId);
+        }
+    }
+
+    size_t touched = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < numUpdates; ++i) {
+        updates.Apply(paths);
+        touched += paths.NumTouched();
+    }
+    std::chrono::duration<double> incremental = std::chrono::steady_clock::now() - start;
+
+    constexpr int numRecomputations = 5;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < numRecomputations; ++i) {
+        DijkstraVisitor visitor;
+        Dijkstra<MinHeap>(graph, 0, visitor);
+    }
+    std::chrono::duration<double> full = std::chrono::steady_clock::now() - start;
+    CheckAgainstDijkstra(graph, paths, 0);
+
+    auto incrementalUs = incremental.count() / numUpdates * 1e6;
+    auto fullUs = full.count() / numRecomputations * 1e6;
+    std::cout << numVertices << " vertices, " << numVertices * averageDegree << " arcs, " <<
+        numUpdates << " updates: incremental " << incrementalUs << " us/update (" <<
+        double(touched) / numUpdates << " vertices touched), full Dijkstra " << fullUs <<
+        " us/update, speedup " << fullUs / incrementalUs << "x\n";
+}
+
+int main() {
+    StressTest();
+    Benchmark(1 << 16, 8, 10'000);
+}
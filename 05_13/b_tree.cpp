@@ -0,0 +1,660 @@
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/*
+ * AVX2 is not enabled by the build flags, so its variants are compiled with a
+ * target attribute and picked at run time when the CPU has it.
+ */
+#if defined(__GNUC__) && defined(__x86_64__)
+#define B_TREE_AVX2_DISPATCH
+
+inline bool HasAvx2() {
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    return hasAvx2;
+}
+#endif
+
+// CountLess for the keys from position `i` on, `result` of the preceding ones being less.
+inline size_t CountLessFrom(const int* keys, size_t count, int key, size_t i, size_t result) {
+#if defined(__SSE2__)
+    auto needle4 = _mm_set1_epi32(key);
+    for (; i + 4 <= count; i += 4) {
+        auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+        auto mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(needle4, block)));
+        result += std::popcount(static_cast<unsigned>(mask));
+        if (mask != 0xF) {
+            return result;
+        }
+    }
+#endif
+    for (; i < count && keys[i] < key; ++i) {
+        ++result;
+    }
+    return result;
+}
+
+// CountLessOrEqual for the keys from position `i` on, `result` of the preceding ones being not greater.
+inline size_t CountLessOrEqualFrom(const int* keys, size_t count, int key, size_t i, size_t result) {
+#if defined(__SSE2__)
+    auto needle4 = _mm_set1_epi32(key);
+    for (; i + 4 <= count; i += 4) {
+        auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+        auto greater = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(block, needle4)));
+        result += 4 - std::popcount(static_cast<unsigned>(greater));
+        if (greater != 0) {
+            return result;
+        }
+    }
+#endif
+    for (; i < count && keys[i] <= key; ++i) {
+        ++result;
+    }
+    return result;
+}
+
+#if defined(B_TREE_AVX2_DISPATCH)
+__attribute__((target("avx2"))) inline size_t CountLessAvx2(const int* keys, size_t count, int key) {
+    size_t result = 0;
+    size_t i = 0;
+    auto needle8 = _mm256_set1_epi32(key);
+    for (; i + 8 <= count; i += 8) {
+        auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+        auto mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(needle8, block)));
+        result += std::popcount(static_cast<unsigned>(mask));
+        if (mask != 0xFF) {
+            return result;
+        }
+    }
+    return CountLessFrom(keys, count, key, i, result);
+}
+
+__attribute__((target("avx2"))) inline size_t CountLessOrEqualAvx2(const int* keys, size_t count, int key) {
+    size_t result = 0;
+    size_t i = 0;
+    auto needle8 = _mm256_set1_epi32(key);
+    for (; i + 8 <= count; i += 8) {
+        auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+        auto greater = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(block, needle8)));
+        result += 8 - std::popcount(static_cast<unsigned>(greater));
+        if (greater != 0) {
+            return result;
+        }
+    }
+    return CountLessOrEqualFrom(keys, count, key, i, result);
+}
+#endif
+
+/*
+ * Number of keys in the sorted range [keys, keys + count) that are less than `key`,
+ * i.e. the lower bound position. Nodes are small, so a linear scan comparing
+ * 8 (AVX2) or 4 (SSE2) keys per instruction beats a branchy binary search.
+ */
+inline size_t CountLess(const int* keys, size_t count, int key) {
+#if defined(B_TREE_AVX2_DISPATCH)
+    if (HasAvx2()) {
+        return CountLessAvx2(keys, count, key);
+    }
+#endif
+    return CountLessFrom(keys, count, key, 0, 0);
+}
+
+// Same as CountLess, but counts keys that are not greater than `key` (the upper bound position).
+inline size_t CountLessOrEqual(const int* keys, size_t count, int key) {
+#if defined(B_TREE_AVX2_DISPATCH)
+    if (HasAvx2()) {
+        return CountLessOrEqualAvx2(keys, count, key);
+    }
+#endif
+    return CountLessOrEqualFrom(keys, count, key, 0, 0);
+}
+
+/*
+ * B+-tree ordered set of ints with the same interface as RbTree.
+ * Every node occupies NODE_BYTES (a few cache lines), so a lookup touches
+ * about log_20(n) nodes instead of log_2(n). All keys live in the leaves,
+ * which are chained left to right for iteration.
+ */
+class BTree {
+public:
+    static constexpr inline size_t CACHE_LINE = 64;
+    static constexpr inline size_t NODE_BYTES = 4 * CACHE_LINE;
+
+private:
+    struct Node {
+        uint32_t count = 0;
+        bool isLeaf = false;
+    };
+
+    static constexpr inline size_t LEAF_CAPACITY =
+        (NODE_BYTES - sizeof(Node) - sizeof(Node*)) / sizeof(int);
+    static constexpr inline size_t INNER_CAPACITY =
+        (NODE_BYTES - sizeof(Node) - sizeof(Node*)) / (sizeof(int) + sizeof(Node*));
+
+    struct alignas(CACHE_LINE) Leaf : Node {
+        Leaf() {
+            isLeaf = true;
+        }
+
+        int keys[LEAF_CAPACITY];
+        Leaf* next = nullptr;
+    };
+
+    // keys[i] is the smallest key in the subtree children[i + 1].
+    struct alignas(CACHE_LINE) Inner : Node {
+        int keys[INNER_CAPACITY];
+        Node* children[INNER_CAPACITY + 1];
+    };
+
+    static_assert(sizeof(Leaf) == NODE_BYTES);
+    static_assert(sizeof(Inner) == NODE_BYTES);
+
+public:
+    class ConstIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = const int&;
+
+        ConstIterator() = default;
+
+        reference operator*() const {
+            return leaf_->keys[index_];
+        }
+
+        ConstIterator& operator++() {
+            if (++index_ == leaf_->count) {
+                leaf_ = leaf_->next;
+                index_ = 0;
+            }
+            return *this;
+        }
+
+        ConstIterator operator++(int) {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        bool operator==(const ConstIterator&) const = default;
+
+    private:
+        friend class BTree;
+
+        ConstIterator(const Leaf* leaf, size_t index) : leaf_(leaf), index_(index) {
+        }
+
+        const Leaf* leaf_ = nullptr;
+        size_t index_ = 0;
+    };
+
+    BTree() = default;
+    BTree(const BTree&) = delete;
+    BTree& operator=(const BTree&) = delete;
+
+    ~BTree() {
+        Delete(root_);
+    }
+
+    bool Contains(int key) const {
+        if (!root_) {
+            return false;
+        }
+        const Node* node = root_;
+        while (!node->isLeaf) {
+            auto inner = static_cast<const Inner*>(node);
+            node = inner->children[CountLessOrEqual(inner->keys, inner->count, key)];
+        }
+        auto leaf = static_cast<const Leaf*>(node);
+        auto pos = CountLess(leaf->keys, leaf->count, key);
+        return pos < leaf->count && leaf->keys[pos] == key;
+    }
+
+    void Insert(int key) {
+        if (!root_) {
+            first_ = new Leaf();
+            root_ = first_;
+        }
+        auto split = Insert(root_, key);
+        if (split.node) {
+            auto root = new Inner();
+            root->count = 1;
+            root->keys[0] = split.separator;
+            root->children[0] = root_;
+            root->children[1] = split.node;
+            root_ = root;
+        }
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    ConstIterator begin() const {
+        if (!first_ || first_->count == 0) {
+            return end();
+        }
+        return {first_, 0};
+    }
+
+    ConstIterator end() const {
+        return {};
+    }
+
+private:
+    struct Split {
+        int separator = 0;
+        Node* node = nullptr;
+    };
+
+    void Delete(Node* node) {
+        if (!node) {
+            return;
+        }
+        if (node->isLeaf) {
+            delete static_cast<Leaf*>(node);
+            return;
+        }
+        auto inner = static_cast<Inner*>(node);
+        for (size_t i = 0; i <= inner->count; ++i) {
+            Delete(inner->children[i]);
+        }
+        delete inner;
+    }
+
+    Split Insert(Node* node, int key) {
+        if (node->isLeaf) {
+            return InsertIntoLeaf(static_cast<Leaf*>(node), key);
+        }
+        auto inner = static_cast<Inner*>(node);
+        auto index = CountLessOrEqual(inner->keys, inner->count, key);
+        auto split = Insert(inner->children[index], key);
+        if (!split.node) {
+            return {};
+        }
+        return InsertIntoInner(inner, index, split);
+    }
+
+    static void InsertAt(Leaf* leaf, size_t pos, int key) {
+        assert(leaf->count < LEAF_CAPACITY);
+        std::copy_backward(leaf->keys + pos, leaf->keys + leaf->count, leaf->keys + leaf->count + 1);
+        leaf->keys[pos] = key;
+        ++leaf->count;
+    }
+
+    Split InsertIntoLeaf(Leaf* leaf, int key) {
+        auto pos = CountLess(leaf->keys, leaf->count, key);
+        if (pos < leaf->count && leaf->keys[pos] == key) {
+            return {};
+        }
+        ++size_;
+        if (leaf->count < LEAF_CAPACITY) {
+            InsertAt(leaf, pos, key);
+            return {};
+        }
+
+        auto right = new Leaf();
+        constexpr size_t half = LEAF_CAPACITY / 2;
+        std::copy(leaf->keys + half, leaf->keys + LEAF_CAPACITY, right->keys);
+        right->count = LEAF_CAPACITY - half;
+        leaf->count = half;
+        right->next = leaf->next;
+        leaf->next = right;
+        if (pos <= half) {
+            InsertAt(leaf, pos, key);
+        } else {
+            InsertAt(right, pos - half, key);
+        }
+        return {right->keys[0], right};
+    }
+
+    // Puts `split` right after children[index]; splits `inner` in two if it is full.
+    Split InsertIntoInner(Inner* inner, size_t index, Split split) {
+        int keys[INNER_CAPACITY + 1];
+        Node* children[INNER_CAPACITY + 2];
+        size_t count = inner->count;
+        std::copy(inner->keys, inner->keys + index, keys);
+        keys[index] = split.separator;
+        std::copy(inner->keys + index, inner->keys + count, keys + index + 1);
+        std::copy(inner->children, inner->children + index + 1, children);
+        children[index + 1] = split.node;
+        std::copy(inner->children + index + 1, inner->children + count + 1, children + index + 2);
+        ++count;
+
+        if (count <= INNER_CAPACITY) {
+            std::copy(keys, keys + count, inner->keys);
+            std::copy(children, children + count + 1, inner->children);
+            inner->count = count;
+            return {};
+        }
+
+        // keys[mid] moves up; the left node keeps keys[0, mid), the right one gets keys(mid, count).
+        auto mid = count / 2;
+        auto right = new Inner();
+        std::copy(keys, keys + mid, inner->keys);
+        std::copy(children, children + mid + 1, inner->children);
+        inner->count = mid;
+        std::copy(keys + mid + 1, keys + count, right->keys);
+        std::copy(children + mid + 1, children + count + 1, right->children);
+        right->count = count - mid - 1;
+        return {keys[mid], right};
+    }
+
+    Node* root_ = nullptr;
+    Leaf* first_ = nullptr;
+    size_t size_ = 0;
+};
+
+enum class Color {
+    BLACK,
+    RED,
+};
+
+struct Node {
+    int key = 0;
+    Node* left = nullptr;
+    Node* right = nullptr;
+    Node* parent = nullptr;
+    Color color = Color::BLACK;
+};
+
+class RbTree {
+public:
+    ~RbTree() {
+        Delete(root_);
+    }
+
+    bool Contains(int key) const {
+        auto candidate = Find(key, root_);
+        return candidate && candidate->key == key;
+    }
+
+    void Insert(int key) {
+        auto candidate = Find(key, root_);
+        if (candidate && candidate->key == key) {
+            return;
+        }
+        ++size_;
+
+        auto node = new Node();
+        node->parent = candidate;
+        node->left = NIL;
+        node->right = NIL;
+        node->key = key;
+        node->color = Color::RED;
+
+        if (!candidate) {
+            assert(!root_);
+            root_ = node;
+        } else if (key < candidate->key) {
+            candidate->left = node;
+        } else {
+            candidate->right = node;
+        }
+
+        InsertCaseOne(node);
+    }
+
+private:
+    void Delete(Node* node) {
+        if (node && node != NIL) {
+            Delete(node->left);
+            Delete(node->right);
+            delete node;
+        }
+    }
+
+    Node* Find(int key, Node* node) const {
+        if (!node) {
+            return nullptr;
+        }
+        if (key < node->key) {
+            if (node->left == NIL) {
+                return node;
+            }
+            return Find(key, node->left);
+        }
+        if (key > node->key) {
+            if (node->right == NIL) {
+                return node;
+            }
+            return Find(key, node->right);
+        }
+        return node;
+    }
+
+    Node* GetUncle(Node* parent, Node* grandparent) const {
+        assert(parent);
+        assert(grandparent);
+        if (parent == grandparent->left) {
+            return grandparent->right;
+        }
+        return grandparent->left;
+    }
+
+    bool IsBlack(const Node* node) const {
+        return node->color == Color::BLACK;
+    }
+
+    void InsertCaseOne(Node* node) {
+        assert(node);
+        if (node == root_) {
+            node->color = Color::BLACK;
+            return;
+        }
+        InsertCaseTwo(node);
+    }
+
+    void InsertCaseTwo(Node* node) {
+        assert(node);
+        assert(!IsBlack(node));
+        auto parent = node->parent;
+        assert(parent);
+        if (IsBlack(parent)) {
+            return;
+        }
+        InsertCaseThree(node, parent);
+    }
+
+    void InsertCaseThree(Node* node, Node* parent) {
+        assert(node);
+        assert(!IsBlack(node));
+        assert(parent);
+        assert(!IsBlack(parent));
+        auto grandparent = parent->parent;
+        auto uncle = GetUncle(parent, grandparent);
+        if (!IsBlack(uncle)) {
+            parent->color = Color::BLACK;
+            uncle->color = Color::BLACK;
+            grandparent->color = Color::RED;
+            InsertCaseOne(grandparent);
+            return;
+        }
+        InsertCaseFour(node, parent, uncle, grandparent);
+    }
+
+    void InsertCaseFour(Node* node, Node* parent, [[maybe_unused]] Node* uncle, Node* grandparent) {
+        assert(node);
+        assert(!IsBlack(node));
+        assert(parent);
+        assert(!IsBlack(parent));
+        assert(uncle);
+        assert(IsBlack(uncle));
+        assert(grandparent);
+        if (node == parent->right && parent == grandparent->left) {
+            RotateLeft(parent);
+            std::swap(node, parent);
+        } else if (node == parent->left && parent == grandparent->right) {
+            RotateRight(parent);
+            std::swap(node, parent);
+        }
+        InsertCaseFive(node, parent, grandparent);
+    }
+
+    void InsertCaseFive(Node* node, Node* parent, Node* grandparent) {
+        parent->color = Color::BLACK;
+        grandparent->color = Color::RED;
+        if (node == parent->left) {
+            RotateRight(grandparent);
+        } else {
+            RotateLeft(grandparent);
+        }
+    }
+
+    void ReplaceChild(Node* parent, Node* oldChild, Node* newChild) {
+        if (!parent) {
+            root_ = newChild;
+        } else if (parent->left == oldChild) {
+            parent->left = newChild;
+        } else {
+            parent->right = newChild;
+        }
+    }
+
+    Node* RotateLeft(Node* node) {
+        assert(node);
+        auto right = node->right;
+        assert(right && node->right != NIL);
+        node->right = right->left;
+        if (right->left != NIL) {
+            right->left->parent = node;
+        }
+        right->parent = node->parent;
+        ReplaceChild(node->parent, node, right);
+        right->left = node;
+        node->parent = right;
+        return right;
+    }
+
+    Node* RotateRight(Node* node) {
+        assert(node);
+        auto left = node->left;
+        assert(left && node->left != NIL);
+        node->left = left->right;
+        if (left->right != NIL) {
+            left->right->parent = node;
+        }
+        left->parent = node->parent;
+        ReplaceChild(node->parent, node, left);
+        left->right = node;
+        node->parent = left;
+        return left;
+    }
+
+    static inline Node nil_;
+    static inline Node* NIL = &nil_;
+    Node* root_ = nullptr;
+    size_t size_ = 0;
+};
+
+void StressTest() {
+    std::mt19937 gen;
+    for (int range : {100, 10000, std::numeric_limits<int>::max()}) {
+        std::uniform_int_distribution<> dis(-range, range);
+        BTree tree;
+        std::set<int> expected;
+        for (int i = 0; i < 20000; ++i) {
+            int key = dis(gen);
+            tree.Insert(key);
+            expected.insert(key);
+        }
+        assert(tree.Size() == expected.size());
+        assert(std::equal(tree.begin(), tree.end(), expected.begin(), expected.end()));
+        for (int i = 0; i < 20000; ++i) {
+            [[maybe_unused]] int key = dis(gen);
+            assert(tree.Contains(key) == expected.contains(key));
+        }
+        for ([[maybe_unused]] auto key : expected) {
+            assert(tree.Contains(key));
+        }
+    }
+
+    BTree edges;
+    for (int key : {std::numeric_limits<int>::max(), std::numeric_limits<int>::min(), 0}) {
+        assert(!edges.Contains(key));
+        edges.Insert(key);
+        assert(edges.Contains(key));
+    }
+}
+
+template <class Set>
+double ContainsThroughput(const Set& set, const std::vector<int>& queries, size_t& found) {
+    auto start = std::chrono::steady_clock::now();
+    for (auto key : queries) {
+        found += set.Contains(key);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return queries.size() / elapsed.count() / 1e6;
+}
+
+// Half of the queries hit, half are (almost certainly) misses.
+void Benchmark(size_t numKeys, size_t numQueries = 1'000'000) {
+    std::mt19937 gen(numKeys);
+    std::uniform_int_distribution<> dis(std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+    std::vector<int> keys(numKeys);
+    for (auto& key : keys) {
+        key = dis(gen);
+    }
+
+    std::vector<int> queries(numQueries);
+    std::uniform_int_distribution<size_t> pick(0, numKeys - 1);
+    for (size_t i = 0; i < numQueries; ++i) {
+        queries[i] = i % 2 ? keys[pick(gen)] : dis(gen);
+    }
+
+    size_t rbFound = 0;
+    size_t bFound = 0;
+    double rbRate = 0;
+    double bRate = 0;
+    {
+        RbTree tree;
+        for (auto key : keys) {
+            tree.Insert(key);
+        }
+        rbRate = ContainsThroughput(tree, queries, rbFound);
+    }
+    {
+        BTree tree;
+        for (auto key : keys) {
+            tree.Insert(key);
+        }
+        bRate = ContainsThroughput(tree, queries, bFound);
+    }
+    if (rbFound != bFound) {
+        std::cerr << "RbTree and BTree disagree: " << rbFound << " vs " << bFound << " hits\n";
+    }
+
+    std::cout << numKeys << " keys, " << bFound << " hits: RbTree " << rbRate << " Mq/s, BTree " << bRate <<
+        " Mq/s, speedup " << bRate / rbRate << "x\n";
+}
+
+// Usage: 05_13_b_tree [numKeys...], e.g. `05_13_b_tree 1000 1000000 100000000`.
+// The 100M run needs several GB of RAM, so it is not run by default.
+int main(int argc, char** argv) {
+    StressTest();
+
+    std::vector<size_t> sizes{1'000, 1'000'000};
+    if (argc > 1) {
+        sizes.clear();
+        for (int i = 1; i < argc; ++i) {
+            sizes.push_back(std::stoull(argv[i]));
+        }
+    }
+    for (auto size : sizes) {
+        Benchmark(size);
+    }
+}
@@ -0,0 +1,762 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+enum class Color {
+    BLACK,
+    RED,
+};
+
+/*
+ * Readers only look at `key`, `left` and `right`, so only those are atomic.
+ * `parent` and `color` belong to the writer.
+ */
+struct Node {
+    std::atomic<int> key = 0;
+    std::atomic<Node*> left = nullptr;
+    std::atomic<Node*> right = nullptr;
+    Node* parent = nullptr;
+    Color color = Color::BLACK;
+
+    int Key() const {
+        return key.load(std::memory_order_relaxed);
+    }
+
+    Node* Left() const {
+        return left.load(std::memory_order_relaxed);
+    }
+
+    Node* Right() const {
+        return right.load(std::memory_order_relaxed);
+    }
+
+    void SetLeft(Node* node) {
+        left.store(node, std::memory_order_relaxed);
+    }
+
+    void SetRight(Node* node) {
+        right.store(node, std::memory_order_relaxed);
+    }
+};
+
+// Slot of the calling thread in the per-tree reader tables. Returned to the pool when the thread exits.
+// Threads beyond MAX_READERS live ones get NONE and always read under the writer lock.
+class ReaderId {
+public:
+    static constexpr inline size_t MAX_READERS = 256;
+    static constexpr inline size_t NONE = MAX_READERS;
+
+    static size_t Get() {
+        thread_local ReaderId id;
+        return id.id_;
+    }
+
+private:
+    ReaderId() {
+        std::lock_guard lock(mutex_);
+        if (!free_.empty()) {
+            id_ = free_.back();
+            free_.pop_back();
+        } else if (next_ < MAX_READERS) {
+            id_ = next_++;
+        }
+    }
+
+    ~ReaderId() {
+        if (id_ != NONE) {
+            std::lock_guard lock(mutex_);
+            free_.push_back(id_);
+        }
+    }
+
+    static inline std::mutex mutex_;
+    static inline std::vector<size_t> free_;
+    static inline size_t next_ = 0;
+
+    size_t id_ = NONE;
+};
+
+/*
+ * Red-black tree with one writer and any number of concurrent readers.
+ *
+ * Readers never lock: they traverse optimistically and validate against a
+ * sequence lock (odd while the writer is restructuring the tree), retrying
+ * when the writer interfered. After a few failed attempts a reader falls
+ * back to the writer mutex, so long range scans cannot starve.
+ *
+ * Erased nodes may still be reachable by readers that started before the
+ * erase, so they are retired and freed only once every active reader has
+ * entered a later epoch.
+ */
+class ConcurrentRbTree {
+public:
+    ConcurrentRbTree() = default;
+    ConcurrentRbTree(const ConcurrentRbTree&) = delete;
+    ConcurrentRbTree& operator=(const ConcurrentRbTree&) = delete;
+
+    ~ConcurrentRbTree() {
+        Delete(root_.load());
+        for (auto [node, epoch] : retired_) {
+            delete node;
+        }
+    }
+
+    bool Contains(int key) const {
+        ReadGuard guard(*this);
+        for (int attempt = 0; guard.Registered() && attempt < MAX_OPTIMISTIC_ATTEMPTS; ++attempt) {
+            auto version = ReadBegin();
+            bool found = false;
+            if (TryFind(key, found) && ReadValidate(version)) {
+                return found;
+            }
+        }
+        std::lock_guard lock(writerMutex_);
+        bool found = false;
+        TryFind(key, found);
+        return found;
+    }
+
+    // All keys in [from, to], in ascending order, as of a single point in time.
+    std::vector<int> RangeScan(int from, int to) const {
+        ReadGuard guard(*this);
+        std::vector<int> keys;
+        for (int attempt = 0; guard.Registered() && attempt < MAX_OPTIMISTIC_ATTEMPTS; ++attempt) {
+            auto version = ReadBegin();
+            keys.clear();
+            if (TryRangeScan(from, to, version, keys) && ReadValidate(version)) {
+                return keys;
+            }
+        }
+        std::lock_guard lock(writerMutex_);
+        keys.clear();
+        TryRangeScan(from, to, sequence_.load(), keys);
+        return keys;
+    }
+
+    void Insert(int key) {
+        std::lock_guard lock(writerMutex_);
+        auto candidate = Find(key);
+        if (candidate && candidate->Key() == key) {
+            return;
+        }
+        ++size_;
+
+        auto node = new Node();
+        node->parent = candidate;
+        node->SetLeft(NIL);
+        node->SetRight(NIL);
+        node->key.store(key, std::memory_order_relaxed);
+        node->color = Color::RED;
+
+        WriteBegin();
+        if (!candidate) {
+            assert(!root_.load());
+            root_.store(node, std::memory_order_relaxed);
+        } else if (key < candidate->Key()) {
+            candidate->SetLeft(node);
+        } else {
+            candidate->SetRight(node);
+        }
+        InsertCaseOne(node);
+        WriteEnd();
+    }
+
+    void Erase(int key) {
+        std::lock_guard lock(writerMutex_);
+        auto node = Find(key);
+        if (!node || node->Key() != key) {
+            return;
+        }
+        --size_;
+
+        WriteBegin();
+        EraseNode(node);
+        WriteEnd();
+
+        Retire(node);
+    }
+
+    size_t Size() const {
+        std::lock_guard lock(writerMutex_);
+        return size_;
+    }
+
+    bool IsRedBlack() const {
+        std::lock_guard lock(writerMutex_);
+        auto root = Root();
+        if (!root) {
+            return true;
+        }
+        return IsBlack(root) && !root->parent && BlackHeight(root) >= 0;
+    }
+
+private:
+    static constexpr inline int MAX_OPTIMISTIC_ATTEMPTS = 8;
+    // A red-black tree over 64-bit sizes is never deeper than this.
+    static constexpr inline size_t MAX_HEIGHT = 128;
+    // How often a range scan checks whether it has already been invalidated.
+    static constexpr inline size_t VALIDATE_EVERY = 64;
+
+    struct alignas(64) ReaderEpoch {
+        std::atomic<uint64_t> epoch = 0;
+    };
+
+    // Publishes the reader's epoch; without a reader slot it is not registered and must not read optimistically.
+    class ReadGuard {
+    public:
+        explicit ReadGuard(const ConcurrentRbTree& tree) {
+            auto id = ReaderId::Get();
+            if (id == ReaderId::NONE) {
+                return;
+            }
+            slot_ = &tree.readers_[id].epoch;
+            slot_->store(tree.epoch_.load(), std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        ~ReadGuard() {
+            if (slot_) {
+                slot_->store(0, std::memory_order_release);
+            }
+        }
+
+        bool Registered() const {
+            return slot_ != nullptr;
+        }
+
+    private:
+        std::atomic<uint64_t>* slot_ = nullptr;
+    };
+
+    uint64_t ReadBegin() const {
+        auto version = sequence_.load(std::memory_order_acquire);
+        while (version & 1) {
+            std::this_thread::yield();
+            version = sequence_.load(std::memory_order_acquire);
+        }
+        return version;
+    }
+
+    bool ReadValidate(uint64_t version) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return sequence_.load(std::memory_order_relaxed) == version;
+    }
+
+    void WriteBegin() {
+        sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void WriteEnd() {
+        sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Returns false if the walk did not terminate in time, i.e. the tree was being restructured.
+    bool TryFind(int key, bool& found) const {
+        auto node = root_.load(std::memory_order_relaxed);
+        for (size_t depth = 0; depth <= MAX_HEIGHT; ++depth) {
+            if (!node || node == NIL) {
+                found = false;
+                return true;
+            }
+            auto nodeKey = node->Key();
+            if (key == nodeKey) {
+                found = true;
+                return true;
+            }
+            node = key < nodeKey ? node->Left() : node->Right();
+        }
+        return false;
+    }
+
+    bool TryRangeScan(int from, int to, uint64_t version, std::vector<int>& keys) const {
+        std::vector<Node*> stack;
+        auto node = root_.load(std::memory_order_relaxed);
+        size_t steps = 0;
+        while ((node && node != NIL) || !stack.empty()) {
+            if (++steps % VALIDATE_EVERY == 0 && !ReadValidate(version)) {
+                return false;
+            }
+            if (node && node != NIL) {
+                if (stack.size() > MAX_HEIGHT) {
+                    return false;
+                }
+                if (node->Key() < from) {
+                    node = node->Right();
+                } else {
+                    stack.push_back(node);
+                    node = node->Left();
+                }
+                continue;
+            }
+            node = stack.back();
+            stack.pop_back();
+            auto key = node->Key();
+            if (key > to) {
+                return true;
+            }
+            keys.push_back(key);
+            node = node->Right();
+        }
+        return true;
+    }
+
+    void Retire(Node* node) {
+        retired_.push_back({node, epoch_.load()});
+        epoch_.fetch_add(1);
+
+        auto oldestReader = epoch_.load();
+        for (const auto& reader : readers_) {
+            auto epoch = reader.epoch.load();
+            if (epoch != 0 && epoch < oldestReader) {
+                oldestReader = epoch;
+            }
+        }
+        std::erase_if(retired_, [oldestReader](const auto& retired) {
+            if (retired.second < oldestReader) {
+                delete retired.first;
+                return true;
+            }
+            return false;
+        });
+    }
+
+    Node* Root() const {
+        return root_.load(std::memory_order_relaxed);
+    }
+
+    void Delete(Node* node) {
+        if (node && node != NIL) {
+            Delete(node->Left());
+            Delete(node->Right());
+            delete node;
+        }
+    }
+
+    int BlackHeight(const Node* node) const {
+        if (node == NIL) {
+            return 0;
+        }
+        auto left = node->Left();
+        auto right = node->Right();
+        if ((left != NIL && (left->parent != node || left->Key() >= node->Key())) ||
+                (right != NIL && (right->parent != node || right->Key() <= node->Key()))) {
+            return -1;
+        }
+        if (!IsBlack(node) && (!IsBlack(left) || !IsBlack(right))) {
+            return -1;
+        }
+        auto leftHeight = BlackHeight(left);
+        if (leftHeight < 0 || leftHeight != BlackHeight(right)) {
+            return -1;
+        }
+        return leftHeight + IsBlack(node);
+    }
+
+    Node* Find(int key) const {
+        auto node = Root();
+        if (!node) {
+            return nullptr;
+        }
+        while (true) {
+            if (key < node->Key()) {
+                if (node->Left() == NIL) {
+                    return node;
+                }
+                node = node->Left();
+            } else if (key > node->Key()) {
+                if (node->Right() == NIL) {
+                    return node;
+                }
+                node = node->Right();
+            } else {
+                return node;
+            }
+        }
+    }
+
+    Node* GetUncle(Node* parent, Node* grandparent) const {
+        assert(parent);
+        assert(grandparent);
+        if (parent == grandparent->Left()) {
+            return grandparent->Right();
+        }
+        return grandparent->Left();
+    }
+
+    bool IsBlack(const Node* node) const {
+        return node->color == Color::BLACK;
+    }
+
+    void InsertCaseOne(Node* node) {
+        assert(node);
+        if (node == Root()) {
+            node->color = Color::BLACK;
+            return;
+        }
+        InsertCaseTwo(node);
+    }
+
+    void InsertCaseTwo(Node* node) {
+        assert(node);
+        assert(!IsBlack(node));
+        auto parent = node->parent;
+        assert(parent);
+        if (IsBlack(parent)) {
+            return;
+        }
+        InsertCaseThree(node, parent);
+    }
+
+    void InsertCaseThree(Node* node, Node* parent) {
+        assert(node);
+        assert(!IsBlack(node));
+        assert(parent);
+        assert(!IsBlack(parent));
+        auto grandparent = parent->parent;
+        auto uncle = GetUncle(parent, grandparent);
+        if (!IsBlack(uncle)) {
+            parent->color = Color::BLACK;
+            uncle->color = Color::BLACK;
+            grandparent->color = Color::RED;
+            InsertCaseOne(grandparent);
+            return;
+        }
+        InsertCaseFour(node, parent, uncle, grandparent);
+    }
+
+    void InsertCaseFour(Node* node, Node* parent, [[maybe_unused]] Node* uncle, Node* grandparent) {
+        assert(node);
+        assert(!IsBlack(node));
+        assert(parent);
+        assert(!IsBlack(parent));
+        assert(uncle);
+        assert(IsBlack(uncle));
+        assert(grandparent);
+        if (node == parent->Right() && parent == grandparent->Left()) {
+            RotateLeft(parent);
+            std::swap(node, parent);
+        } else if (node == parent->Left() && parent == grandparent->Right()) {
+            RotateRight(parent);
+            std::swap(node, parent);
+        }
+        InsertCaseFive(node, parent, grandparent);
+    }
+
+    void InsertCaseFive(Node* node, Node* parent, Node* grandparent) {
+        parent->color = Color::BLACK;
+        grandparent->color = Color::RED;
+        if (node == parent->Left()) {
+            RotateRight(grandparent);
+        } else {
+            RotateLeft(grandparent);
+        }
+    }
+
+    // Puts `replacement` in place of the subtree rooted at `node`.
+    void Transplant(Node* node, Node* replacement) {
+        ReplaceChild(node->parent, node, replacement);
+        if (replacement != NIL) {
+            replacement->parent = node->parent;
+        }
+    }
+
+    void EraseNode(Node* node) {
+        auto removedColor = node->color;
+        Node* child;
+        Node* childParent;
+        if (node->Left() == NIL) {
+            child = node->Right();
+            childParent = node->parent;
+            Transplant(node, child);
+        } else if (node->Right() == NIL) {
+            child = node->Left();
+            childParent = node->parent;
+            Transplant(node, child);
+        } else {
+            auto successor = node->Right();
+            while (successor->Left() != NIL) {
+                successor = successor->Left();
+            }
+            removedColor = successor->color;
+            child = successor->Right();
+            if (successor->parent == node) {
+                childParent = successor;
+            } else {
+                childParent = successor->parent;
+                Transplant(successor, child);
+                successor->SetRight(node->Right());
+                successor->Right()->parent = successor;
+            }
+            Transplant(node, successor);
+            successor->SetLeft(node->Left());
+            successor->Left()->parent = successor;
+            successor->color = node->color;
+        }
+        if (Root() == NIL) {
+            root_.store(nullptr, std::memory_order_relaxed);
+            return;
+        }
+        if (removedColor == Color::BLACK) {
+            EraseFixup(child, childParent);
+        }
+    }
+
+    // `node` carries an extra black; `parent` is passed explicitly because `node` may be NIL.
+    void EraseFixup(Node* node, Node* parent) {
+        while (node != Root() && IsBlack(node)) {
+            if (node == parent->Left()) {
+                auto sibling = parent->Right();
+                if (!IsBlack(sibling)) {
+                    sibling->color = Color::BLACK;
+                    parent->color = Color::RED;
+                    RotateLeft(parent);
+                    sibling = parent->Right();
+                }
+                if (IsBlack(sibling->Left()) && IsBlack(sibling->Right())) {
+                    sibling->color = Color::RED;
+                    node = parent;
+                    parent = node->parent;
+                    continue;
+                }
+                if (IsBlack(sibling->Right())) {
+                    sibling->Left()->color = Color::BLACK;
+                    sibling->color = Color::RED;
+                    RotateRight(sibling);
+                    sibling = parent->Right();
+                }
+                sibling->color = parent->color;
+                parent->color = Color::BLACK;
+                sibling->Right()->color = Color::BLACK;
+                RotateLeft(parent);
+            } else {
+                auto sibling = parent->Left();
+                if (!IsBlack(sibling)) {
+                    sibling->color = Color::BLACK;
+                    parent->color = Color::RED;
+                    RotateRight(parent);
+                    sibling = parent->Left();
+                }
+                if (IsBlack(sibling->Left()) && IsBlack(sibling->Right())) {
+                    sibling->color = Color::RED;
+                    node = parent;
+                    parent = node->parent;
+                    continue;
+                }
+                if (IsBlack(sibling->Left())) {
+                    sibling->Right()->color = Color::BLACK;
+                    sibling->color = Color::RED;
+                    RotateLeft(sibling);
+                    sibling = parent->Left();
+                }
+                sibling->color = parent->color;
+                parent->color = Color::BLACK;
+                sibling->Left()->color = Color::BLACK;
+                RotateRight(parent);
+            }
+            node = Root();
+        }
+        if (node != NIL) {
+            node->color = Color::BLACK;
+        }
+    }
+
+    void ReplaceChild(Node* parent, Node* oldChild, Node* newChild) {
+        if (!parent) {
+            root_.store(newChild, std::memory_order_relaxed);
+        } else if (parent->Left() == oldChild) {
+            parent->SetLeft(newChild);
+        } else {
+            parent->SetRight(newChild);
+        }
+    }
+
+    Node* RotateLeft(Node* node) {
+        assert(node);
+        auto right = node->Right();
+        assert(right && right != NIL);
+        node->SetRight(right->Left());
+        if (right->Left() != NIL) {
+            right->Left()->parent = node;
+        }
+        right->parent = node->parent;
+        ReplaceChild(node->parent, node, right);
+        right->SetLeft(node);
+        node->parent = right;
+        return right;
+    }
+
+    Node* RotateRight(Node* node) {
+        assert(node);
+        auto left = node->Left();
+        assert(left && left != NIL);
+        node->SetLeft(left->Right());
+        if (left->Right() != NIL) {
+            left->Right()->parent = node;
+        }
+        left->parent = node->parent;
+        ReplaceChild(node->parent, node, left);
+        left->SetRight(node);
+        node->parent = left;
+        return left;
+    }
+
+    static inline Node nil_;
+    static inline Node* NIL = &nil_;
+    std::atomic<Node*> root_ = nullptr;
+    size_t size_ = 0;
+
+    mutable std::mutex writerMutex_;
+    std::atomic<uint64_t> sequence_ = 0;
+
+    std::atomic<uint64_t> epoch_ = 1;
+    mutable std::array<ReaderEpoch, ReaderId::MAX_READERS> readers_;
+    std::vector<std::pair<Node*, uint64_t>> retired_;
+};
+
+void SequentialTest() {
+    std::mt19937 gen;
+    std::uniform_int_distribution<> dis(-300, 300);
+    ConcurrentRbTree tree;
+    std::set<int> expected;
+    for (int i = 0; i < 20000; ++i) {
+        int key = dis(gen);
+        if (gen() % 2) {
+            tree.Insert(key);
+            expected.insert(key);
+        } else {
+            tree.Erase(key);
+            expected.erase(key);
+        }
+        assert(tree.Size() == expected.size());
+        assert(tree.Contains(key) == expected.contains(key));
+        if (i % 100 == 0) {
+            assert(tree.IsRedBlack());
+            auto scan = tree.RangeScan(-100, 100);
+            assert(std::equal(scan.begin(), scan.end(),
+                expected.lower_bound(-100), expected.upper_bound(100)));
+        }
+    }
+}
+
+/*
+ * Even keys in [0, STABLE) are never erased and keys >= MISSING are never inserted,
+ * so readers can check their answers while the writer churns odd keys.
+ */
+void ConcurrentTest() {
+    constexpr int STABLE = 1000;
+    [[maybe_unused]] constexpr int MISSING = 1'000'000;
+    ConcurrentRbTree tree;
+    for (int key = 0; key < STABLE; key += 2) {
+        tree.Insert(key);
+    }
+
+    std::atomic<bool> stop = false;
+    std::thread writer([&] {
+        std::mt19937 gen(1);
+        std::uniform_int_distribution<> dis(0, STABLE / 2 - 1);
+        for (int i = 0; i < 200000; ++i) {
+            int key = 2 * dis(gen) + 1;
+            if (gen() % 2) {
+                tree.Insert(key);
+            } else {
+                tree.Erase(key);
+            }
+        }
+        stop = true;
+    });
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r) {
+        readers.emplace_back([&, r] {
+            std::mt19937 gen(r);
+            std::uniform_int_distribution<> dis(0, STABLE / 2 - 1);
+            while (!stop) {
+                assert(tree.Contains(2 * dis(gen)));
+                assert(!tree.Contains(MISSING + dis(gen)));
+                auto scan = tree.RangeScan(0, STABLE);
+                assert(std::is_sorted(scan.begin(), scan.end()));
+                [[maybe_unused]] auto even = std::count_if(scan.begin(), scan.end(), [](int key) {
+                    return key % 2 == 0;
+                });
+                assert(even == STABLE / 2);
+            }
+        });
+    }
+
+    writer.join();
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    assert(tree.IsRedBlack());
+}
+
+/*
+ * Contains throughput with 1..64 readers while a writer keeps erasing and re-inserting keys.
+ */
+void Benchmark(int numKeys = 1'000'000, std::chrono::milliseconds duration = std::chrono::milliseconds(300)) {
+    ConcurrentRbTree tree;
+    for (int i = 0; i < numKeys; ++i) {
+        tree.Insert(2 * i);
+    }
+
+    for (int numReaders = 1; numReaders <= 64; numReaders *= 2) {
+        std::atomic<bool> stop = false;
+        std::atomic<size_t> reads = 0;
+        std::atomic<size_t> hits = 0;
+        size_t writes = 0;
+
+        std::thread writer([&] {
+            std::mt19937 gen(numReaders);
+            std::uniform_int_distribution<> dis(0, numKeys - 1);
+            while (!stop) {
+                int key = 2 * dis(gen);
+                tree.Erase(key);
+                tree.Insert(key);
+                writes += 2;
+            }
+        });
+
+        std::vector<std::thread> readers;
+        for (int r = 0; r < numReaders; ++r) {
+            readers.emplace_back([&, r] {
+                std::mt19937 gen(r);
+                std::uniform_int_distribution<> dis(0, 2 * numKeys);
+                size_t local = 0;
+                size_t found = 0;
+                while (!stop) {
+                    found += tree.Contains(dis(gen));
+                    ++local;
+                }
+                reads += local;
+                hits += found;
+            });
+        }
+
+        std::this_thread::sleep_for(duration);
+        stop = true;
+        writer.join();
+        for (auto& reader : readers) {
+            reader.join();
+        }
+
+        double seconds = std::chrono::duration<double>(duration).count();
+        std::cout << numReaders << " readers: " << reads / seconds / 1e6 << " Mreads/s, " <<
+            writes / seconds / 1e6 << " Mwrites/s\n";
+    }
+}
+
+int main() {
+    SequentialTest();
+    ConcurrentTest();
+    Benchmark();
+}
@@ -0,0 +1,434 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+enum class Color {
+    BLACK,
+    RED,
+};
+
+struct Node;
+
+// Shared ownership of an immutable node, like std::shared_ptr but without a separate control block.
+class NodePtr {
+public:
+    NodePtr() = default;
+
+    // Adopts a freshly allocated node.
+    explicit NodePtr(Node* node) : node_(node) {
+    }
+
+    NodePtr(const NodePtr& other);
+    NodePtr(NodePtr&& other) noexcept : node_(std::exchange(other.node_, nullptr)) {
+    }
+
+    NodePtr& operator=(NodePtr other) noexcept {
+        std::swap(node_, other.node_);
+        return *this;
+    }
+
+    ~NodePtr();
+
+    const Node* operator->() const {
+        return node_;
+    }
+
+    explicit operator bool() const {
+        return node_;
+    }
+
+    const Node* Get() const {
+        return node_;
+    }
+
+private:
+    Node* node_ = nullptr;
+};
+
+/*
+ * Nodes are never modified after construction, so any number of tree
+ * versions can share them. A node is freed when the last version or
+ * parent referring to it goes away.
+ */
+struct Node {
+    Node(Color color, NodePtr left, int key, NodePtr right)
+        : key(key), color(color), left(std::move(left)), right(std::move(right))
+    {
+        alive.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~Node() {
+        alive.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    int key = 0;
+    Color color = Color::BLACK;
+    NodePtr left;
+    NodePtr right;
+    mutable std::atomic<uint32_t> refs = 1;
+
+    static inline std::atomic<size_t> alive = 0;
+};
+
+NodePtr::NodePtr(const NodePtr& other) : node_(other.node_) {
+    if (node_) {
+        node_->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+NodePtr::~NodePtr() {
+    if (node_ && node_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete node_;
+    }
+}
+
+/*
+ * Persistent red-black tree: Insert and Erase leave `*this` untouched and
+ * return a new version that shares all but O(log n) nodes with it.
+ * Versions are cheap to copy and can be read from any thread.
+ *
+ * The rebalancing follows S. Kahrs, "Red-black trees with types" (2001),
+ * which extends Okasaki's functional insertion with deletion.
+ */
+class PersistentRbTree {
+public:
+    PersistentRbTree() = default;
+
+    bool Contains(int key) const {
+        auto node = root_.Get();
+        while (node) {
+            if (key < node->key) {
+                node = node->left.Get();
+            } else if (key > node->key) {
+                node = node->right.Get();
+            } else {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    [[nodiscard]] PersistentRbTree Insert(int key) const {
+        if (Contains(key)) {
+            return *this;
+        }
+        return {MakeBlack(Insert(root_, key)), size_ + 1};
+    }
+
+    [[nodiscard]] PersistentRbTree Erase(int key) const {
+        if (!Contains(key)) {
+            return *this;
+        }
+        return {MakeBlack(Erase(root_, key)), size_ - 1};
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    std::vector<int> Keys() const {
+        std::vector<int> keys;
+        keys.reserve(size_);
+        CollectKeys(root_.Get(), keys);
+        return keys;
+    }
+
+    bool IsRedBlack() const {
+        return !IsRed(root_) && BlackHeight(root_.Get()) >= 0;
+    }
+
+    // Number of nodes currently allocated by all versions of all trees.
+    static size_t NumLiveNodes() {
+        return Node::alive.load();
+    }
+
+private:
+    PersistentRbTree(NodePtr root, size_t size) : root_(std::move(root)), size_(size) {
+    }
+
+    static NodePtr Make(Color color, NodePtr left, int key, NodePtr right) {
+        return NodePtr(new Node(color, std::move(left), key, std::move(right)));
+    }
+
+    static bool IsRed(const NodePtr& node) {
+        return node && node->color == Color::RED;
+    }
+
+    // A non-empty black node; empty leaves are black too, but the rebalancing cases need to tell them apart.
+    static bool IsBlackNode(const NodePtr& node) {
+        return node && node->color == Color::BLACK;
+    }
+
+    static NodePtr Recolor(const NodePtr& node, Color color) {
+        if (node->color == color) {
+            return node;
+        }
+        return Make(color, node->left, node->key, node->right);
+    }
+
+    static NodePtr MakeBlack(const NodePtr& node) {
+        if (!node) {
+            return {};
+        }
+        return Recolor(node, Color::BLACK);
+    }
+
+    // Builds a black node over `left, key, right`, fixing a red-red violation in either child.
+    static NodePtr Balance(const NodePtr& left, int key, const NodePtr& right) {
+        if (IsRed(left) && IsRed(right)) {
+            return Make(Color::RED,
+                Recolor(left, Color::BLACK), key, Recolor(right, Color::BLACK));
+        }
+        if (IsRed(left) && IsRed(left->left)) {
+            return Make(Color::RED,
+                Recolor(left->left, Color::BLACK),
+                left->key,
+                Make(Color::BLACK, left->right, key, right));
+        }
+        if (IsRed(left) && IsRed(left->right)) {
+            return Make(Color::RED,
+                Make(Color::BLACK, left->left, left->key, left->right->left),
+                left->right->key,
+                Make(Color::BLACK, left->right->right, key, right));
+        }
+        if (IsRed(right) && IsRed(right->right)) {
+            return Make(Color::RED,
+                Make(Color::BLACK, left, key, right->left),
+                right->key,
+                Recolor(right->right, Color::BLACK));
+        }
+        if (IsRed(right) && IsRed(right->left)) {
+            return Make(Color::RED,
+                Make(Color::BLACK, left, key, right->left->left),
+                right->left->key,
+                Make(Color::BLACK, right->left->right, right->key, right->right));
+        }
+        return Make(Color::BLACK, left, key, right);
+    }
+
+    static NodePtr Insert(const NodePtr& node, int key) {
+        if (!node) {
+            return Make(Color::RED, {}, key, {});
+        }
+        assert(key != node->key);
+        if (node->color == Color::BLACK) {
+            if (key < node->key) {
+                return Balance(Insert(node->left, key), node->key, node->right);
+            }
+            return Balance(node->left, node->key, Insert(node->right, key));
+        }
+        if (key < node->key) {
+            return Make(Color::RED, Insert(node->left, key), node->key, node->right);
+        }
+        return Make(Color::RED, node->left, node->key, Insert(node->right, key));
+    }
+
+    // `left` has a black height one less than `right`.
+    static NodePtr BalanceLeft(const NodePtr& left, int key, const NodePtr& right) {
+        if (IsRed(left)) {
+            return Make(Color::RED, Recolor(left, Color::BLACK), key, right);
+        }
+        if (IsBlackNode(right)) {
+            return Balance(left, key, Recolor(right, Color::RED));
+        }
+        assert(IsRed(right) && IsBlackNode(right->left));
+        return Make(Color::RED,
+            Make(Color::BLACK, left, key, right->left->left),
+            right->left->key,
+            Balance(right->left->right, right->key, Recolor(right->right, Color::RED)));
+    }
+
+    // `right` has a black height one less than `left`.
+    static NodePtr BalanceRight(const NodePtr& left, int key, const NodePtr& right) {
+        if (IsRed(right)) {
+            return Make(Color::RED, left, key, Recolor(right, Color::BLACK));
+        }
+        if (IsBlackNode(left)) {
+            return Balance(Recolor(left, Color::RED), key, right);
+        }
+        assert(IsRed(left) && IsBlackNode(left->right));
+        return Make(Color::RED,
+            Balance(Recolor(left->left, Color::RED), left->key, left->right->left),
+            left->right->key,
+            Make(Color::BLACK, left->right->right, key, right));
+    }
+
+    // Joins two subtrees of equal black height where all keys of `left` precede those of `right`.
+    static NodePtr Append(const NodePtr& left, const NodePtr& right) {
+        if (!left) {
+            return right;
+        }
+        if (!right) {
+            return left;
+        }
+        if (IsRed(left) && IsRed(right)) {
+            auto middle = Append(left->right, right->left);
+            if (IsRed(middle)) {
+                return Make(Color::RED,
+                    Make(Color::RED, left->left, left->key, middle->left),
+                    middle->key,
+                    Make(Color::RED, middle->right, right->key, right->right));
+            }
+            return Make(Color::RED,
+                left->left, left->key, Make(Color::RED, middle, right->key, right->right));
+        }
+        if (IsBlackNode(left) && IsBlackNode(right)) {
+            auto middle = Append(left->right, right->left);
+            if (IsRed(middle)) {
+                return Make(Color::RED,
+                    Make(Color::BLACK, left->left, left->key, middle->left),
+                    middle->key,
+                    Make(Color::BLACK, middle->right, right->key, right->right));
+            }
+            return BalanceLeft(left->left, left->key, Make(Color::BLACK, middle, right->key, right->right));
+        }
+        if (IsRed(right)) {
+            return Make(Color::RED, Append(left, right->left), right->key, right->right);
+        }
+        return Make(Color::RED, left->left, left->key, Append(left->right, right));
+    }
+
+    static NodePtr Erase(const NodePtr& node, int key) {
+        assert(node);
+        if (key < node->key) {
+            if (IsBlackNode(node->left)) {
+                return BalanceLeft(Erase(node->left, key), node->key, node->right);
+            }
+            return Make(Color::RED, Erase(node->left, key), node->key, node->right);
+        }
+        if (key > node->key) {
+            if (IsBlackNode(node->right)) {
+                return BalanceRight(node->left, node->key, Erase(node->right, key));
+            }
+            return Make(Color::RED, node->left, node->key, Erase(node->right, key));
+        }
+        return Append(node->left, node->right);
+    }
+
+    static void CollectKeys(const Node* node, std::vector<int>& keys) {
+        if (node) {
+            CollectKeys(node->left.Get(), keys);
+            keys.push_back(node->key);
+            CollectKeys(node->right.Get(), keys);
+        }
+    }
+
+    static int BlackHeight(const Node* node) {
+        if (!node) {
+            return 0;
+        }
+        if (node->color == Color::RED && (IsRed(node->left) || IsRed(node->right))) {
+            return -1;
+        }
+        if ((node->left && node->left->key >= node->key) ||
+                (node->right && node->right->key <= node->key)) {
+            return -1;
+        }
+        auto left = BlackHeight(node->left.Get());
+        if (left < 0 || left != BlackHeight(node->right.Get())) {
+            return -1;
+        }
+        return left + (node->color == Color::BLACK);
+    }
+
+    NodePtr root_;
+    size_t size_ = 0;
+};
+
+// Every version ever produced must stay intact while newer versions are derived from it.
+void StressTest() {
+    std::mt19937 gen;
+    std::uniform_int_distribution<> dis(-200, 200);
+    {
+        std::vector<PersistentRbTree> versions(1);
+        std::vector<std::set<int>> expected(1);
+        for (int i = 0; i < 3000; ++i) {
+            auto base = gen() % versions.size();
+            int key = dis(gen);
+            auto keys = expected[base];
+            if (gen() % 3) {
+                versions.push_back(versions[base].Insert(key));
+                keys.insert(key);
+            } else {
+                versions.push_back(versions[base].Erase(key));
+                keys.erase(key);
+            }
+            expected.push_back(std::move(keys));
+            assert(versions.back().IsRedBlack());
+            assert(versions.back().Contains(key) == expected.back().contains(key));
+        }
+        for (size_t v = 0; v < versions.size(); ++v) {
+            auto keys = versions[v].Keys();
+            assert(versions[v].Size() == expected[v].size());
+            assert(std::equal(keys.begin(), keys.end(), expected[v].begin(), expected[v].end()));
+        }
+    }
+    assert(PersistentRbTree::NumLiveNodes() == 0);
+}
+
+/*
+ * Keeps `numVersions` snapshots alive, each one insert or erase away from the previous,
+ * and reports how many bytes each snapshot adds on top of the base tree.
+ * Erased keys are always present and inserted ones always absent, so every version is a real path copy.
+ */
+void Benchmark(int numKeys, int numVersions) {
+    std::mt19937 gen(numKeys);
+    std::vector<int> present(numKeys);
+    std::vector<int> absent(numKeys);
+    for (int i = 0; i < numKeys; ++i) {
+        present[i] = 2 * i;
+        absent[i] = 2 * i + 1;
+    }
+    std::shuffle(present.begin(), present.end(), gen);
+
+    PersistentRbTree tree;
+    for (auto key : present) {
+        tree = tree.Insert(key);
+    }
+    auto baseNodes = PersistentRbTree::NumLiveNodes();
+
+    // Removes a random key from `keys` and returns it.
+    auto take = [&gen](std::vector<int>& keys) {
+        std::swap(keys[gen() % keys.size()], keys.back());
+        auto key = keys.back();
+        keys.pop_back();
+        return key;
+    };
+
+    std::vector<PersistentRbTree> versions{tree};
+    size_t numChanged = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < numVersions; ++i) {
+        if (i % 2) {
+            auto key = take(absent);
+            versions.push_back(versions.back().Insert(key));
+            present.push_back(key);
+        } else {
+            auto key = take(present);
+            versions.push_back(versions.back().Erase(key));
+            absent.push_back(key);
+        }
+        numChanged += versions.back().Size() != versions[versions.size() - 2].Size();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    double nodesPerVersion = double(PersistentRbTree::NumLiveNodes() - baseNodes) / numChanged;
+    std::cout << tree.Size() << " keys: " << nodesPerVersion << " nodes (" <<
+        nodesPerVersion * sizeof(Node) << " bytes) per version vs " <<
+        tree.Size() * sizeof(Node) << " bytes per full copy, " <<
+        elapsed.count() / numVersions * 1e6 << " us per update\n";
+}
+
+int main() {
+    StressTest();
+    for (int numKeys : {1'000, 100'000, 1'000'000}) {
+        Benchmark(numKeys, 10'000);
+    }
+}
@@ -1,5 +1,11 @@
+#include "common/stats.h"
+
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <span>
 #include <vector>
 
 enum class Color {
@@ -52,6 +58,60 @@ public:
         InsertCaseOne(node);
     }
 
+    /*
+     * Sorted keys are inserted one after another, so each search mostly walks
+     * the path the previous one has just brought into cache.
+     */
+    void InsertBatch(std::span<const int> keys) {
+        std::vector<int> sorted(keys.begin(), keys.end());
+        std::sort(sorted.begin(), sorted.end());
+        sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+        for (auto key : sorted) {
+            Insert(key);
+        }
+    }
+
+    /*
+     * found[i] = Contains(keys[i]). Up to BATCH_WIDTH searches descend in lockstep:
+     * each one prefetches its next node and yields to the others, so their cache
+     * misses overlap instead of stalling one after another.
+     */
+    void ContainsBatch(std::span<const int> keys, std::span<bool> found) const {
+        assert(keys.size() == found.size());
+        for (size_t begin = 0; begin < keys.size(); begin += BATCH_WIDTH) {
+            auto width = std::min(BATCH_WIDTH, keys.size() - begin);
+            const Node* nodes[BATCH_WIDTH];
+            size_t active = 0;
+            for (size_t i = 0; i < width; ++i) {
+                found[begin + i] = false;
+                nodes[i] = root_;
+                active += root_ != nullptr;
+            }
+            while (active) {
+                for (size_t i = 0; i < width; ++i) {
+                    auto node = nodes[i];
+                    if (!node) {
+                        continue;
+                    }
+                    auto key = keys[begin + i];
+                    if (node == NIL || node->key == key) {
+                        found[begin + i] = node != NIL;
+                        nodes[i] = nullptr;
+                        --active;
+                        continue;
+                    }
+                    auto next = key < node->key ? node->left : node->right;
+                    __builtin_prefetch(next);
+                    nodes[i] = next;
+                }
+            }
+        }
+    }
+
+    size_t Height() const {
+        return Height(root_);
+    }
+
     void Print() const {
         std::cout << size_ << '\n';
         Print(root_);
@@ -81,6 +141,13 @@ public:
     }
 
 private:
+    size_t Height(const Node* node) const {
+        if (!node || node == NIL) {
+            return 0;
+        }
+        return 1 + std::max(Height(node->left), Height(node->right));
+    }
+
     void Delete(Node* node) {
         if (node && node != NIL) {
             Delete(node->left);
@@ -122,6 +189,7 @@ private:
     }
 
     void InsertCaseOne(Node* node) {
+        STATS_INCREMENT("rb_tree.insert_case_1");
         assert(node);
         if (node == root_) {
             node->color = Color::BLACK;
@@ -131,6 +199,7 @@ private:
     }
 
     void InsertCaseTwo(Node* node) {
+        STATS_INCREMENT("rb_tree.insert_case_2");
         assert(node);
         assert(!IsBlack(node));
         auto parent = node->parent;
@@ -142,14 +211,25 @@ private:
     }
 
     void InsertCaseThree(Node* node, Node* parent) {
+        STATS_INCREMENT("rb_tree.insert_case_3");
         assert(node);
         assert(!IsBlack(node));
         assert(parent);
         assert(!IsBlack(parent));
-        // Your code goes here
+        auto grandparent = parent->parent;
+        auto uncle = GetUncle(parent, grandparent);
+        if (!IsBlack(uncle)) {
+            parent->color = Color::BLACK;
+            uncle->color = Color::BLACK;
+            grandparent->color = Color::RED;
+            InsertCaseOne(grandparent);
+            return;
+        }
+        InsertCaseFour(node, parent, uncle, grandparent);
     }
 
-    void InsertCaseFour(Node* node, Node* parent, Node* uncle, Node* grandparent) {
+    void InsertCaseFour(Node* node, Node* parent, [[maybe_unused]] Node* uncle, Node* grandparent) {
+        STATS_INCREMENT("rb_tree.insert_case_4");
         assert(node);
         assert(!IsBlack(node));
         assert(parent);
@@ -157,33 +237,109 @@ private:
         assert(uncle);
         assert(IsBlack(uncle));
         assert(grandparent);
-        // Your code goes here
+        if (node == parent->right && parent == grandparent->left) {
+            RotateLeft(parent);
+            std::swap(node, parent);
+        } else if (node == parent->left && parent == grandparent->right) {
+            RotateRight(parent);
+            std::swap(node, parent);
+        }
+        InsertCaseFive(node, parent, grandparent);
+    }
+
+    void InsertCaseFive(Node* node, Node* parent, Node* grandparent) {
+        STATS_INCREMENT("rb_tree.insert_case_5");
+        parent->color = Color::BLACK;
+        grandparent->color = Color::RED;
+        if (node == parent->left) {
+            RotateRight(grandparent);
+        } else {
+            RotateLeft(grandparent);
+        }
     }
 
-    void InsertCaseFive(/* Your code goes here */) {
-        // Your code goes here
+    void ReplaceChild(Node* parent, Node* oldChild, Node* newChild) {
+        if (!parent) {
+            root_ = newChild;
+        } else if (parent->left == oldChild) {
+            parent->left = newChild;
+        } else {
+            parent->right = newChild;
+        }
     }
 
     Node* RotateLeft(Node* node) {
+        STATS_INCREMENT("rb_tree.rotations");
         assert(node);
         auto right = node->right;
         assert(right && node->right != NIL);
-        // Your code goes here
+        node->right = right->left;
+        if (right->left != NIL) {
+            right->left->parent = node;
+        }
+        right->parent = node->parent;
+        ReplaceChild(node->parent, node, right);
+        right->left = node;
+        node->parent = right;
+        return right;
     }
 
     Node* RotateRight(Node* node) {
+        STATS_INCREMENT("rb_tree.rotations");
         assert(node);
         auto left = node->left;
         assert(left && node->left != NIL);
-        // Your code goes here
+        node->left = left->right;
+        if (left->right != NIL) {
+            left->right->parent = node;
+        }
+        left->parent = node->parent;
+        ReplaceChild(node->parent, node, left);
+        left->right = node;
+        node->parent = left;
+        return left;
     }
 
+    friend bool IsRedBlack(const RbTree& tree);
+
+    static constexpr inline size_t BATCH_WIDTH = 16;
     static inline Node nil_;
     static inline Node* NIL = &nil_;
     Node* root_ = nullptr;
     size_t size_ = 0;
 };
 
+// Returns the black height of the subtree, or -1 if it breaks the red-black properties.
+int BlackHeight(const Node* node, const Node* nil) {
+    if (node == nil) {
+        return 0;
+    }
+    for (auto child : {node->left, node->right}) {
+        if (child != nil && child->parent != node) {
+            return -1;
+        }
+        if (node->color == Color::RED && child->color == Color::RED) {
+            return -1;
+        }
+    }
+    if ((node->left != nil && node->left->key >= node->key) ||
+            (node->right != nil && node->right->key <= node->key)) {
+        return -1;
+    }
+    auto left = BlackHeight(node->left, nil);
+    if (left < 0 || left != BlackHeight(node->right, nil)) {
+        return -1;
+    }
+    return left + (node->color == Color::BLACK);
+}
+
+bool IsRedBlack(const RbTree& tree) {
+    if (!tree.root_) {
+        return true;
+    }
+    return tree.root_->color == Color::BLACK && BlackHeight(tree.root_, RbTree::NIL) >= 0;
+}
+
 #include <random>
 
 // Don't forget to look in the debugger to see the actual state of your tree.
@@ -198,13 +354,71 @@ void StressTest() {
         int key = dis(gen);
         keys.push_back(key);
         tree.Insert(key);
-        for (auto inserted : keys) {
+        for ([[maybe_unused]] auto inserted : keys) {
             assert(tree.Contains(inserted));
         }
-//        assert(IsRedBlack(tree));
+        assert(IsRedBlack(tree));
+    }
+
+    RbTree batched;
+    batched.InsertBatch(keys);
+    assert(IsRedBlack(batched));
+    std::vector<int> queries;
+    for (int i = 0; i < numQueries; ++i) {
+        queries.push_back(2 * dis(gen));
+    }
+    std::unique_ptr<bool[]> found(new bool[queries.size()]);
+    batched.ContainsBatch(queries, std::span(found.get(), queries.size()));
+    for (size_t i = 0; i < queries.size(); ++i) {
+        assert(found[i] == tree.Contains(queries[i]));
     }
 }
 
+// Compares one-by-one Contains with ContainsBatch on random keys.
+void Benchmark(int numKeys, int numQueries = 1'000'000) {
+    std::mt19937 gen(numKeys);
+    std::uniform_int_distribution<> dis(std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+    std::vector<int> keys(numKeys);
+    for (auto& key : keys) {
+        key = dis(gen);
+    }
+    RbTree tree;
+    tree.InsertBatch(keys);
+    STATS_MAX("rb_tree.max_height", tree.Height());
+
+    std::vector<int> queries(numQueries);
+    for (int i = 0; i < numQueries; ++i) {
+        queries[i] = i % 2 ? keys[gen() % numKeys] : dis(gen);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    size_t single = 0;
+    {
+        STATS_SCOPED_PERF("rb_tree.contains");
+        for (auto key : queries) {
+            single += tree.Contains(key);
+        }
+    }
+    std::chrono::duration<double> singleTime = std::chrono::steady_clock::now() - start;
+
+    std::unique_ptr<bool[]> found(new bool[numQueries]);
+    start = std::chrono::steady_clock::now();
+    {
+        STATS_SCOPED_PERF("rb_tree.contains_batch");
+        tree.ContainsBatch(queries, std::span(found.get(), numQueries));
+    }
+    std::chrono::duration<double> batchTime = std::chrono::steady_clock::now() - start;
+    assert(single == size_t(std::count(found.get(), found.get() + numQueries, true)));
+
+    std::cout << numKeys << " keys, " << single << " hits: Contains " <<
+        numQueries / singleTime.count() / 1e6 << " Mq/s, ContainsBatch " <<
+        numQueries / batchTime.count() / 1e6 << " Mq/s\n";
+}
+
 int main() {
     StressTest();
+    for (int numKeys : {1'000, 1'000'000}) {
+        Benchmark(numKeys);
+    }
+    STATS_DUMP_JSON(std::cerr);
 }
@@ -0,0 +1,206 @@
+#pragma once
+
+/*
+ * Optional hot-path instrumentation.
+ *
+ * Configure with -DENABLE_INSTRUMENTATION=ON to collect named counters,
+ * maxima, scoped timers and (on Linux) hardware cache and branch misses,
+ * then print them all with STATS_DUMP_JSON. Without the option every macro
+ * below expands to nothing and its arguments are not even evaluated.
+ *
+ * Names must be string literals; each call site caches its slot in a
+ * function-local static, so the hot path is a single relaxed atomic add.
+ */
+
+#ifdef ENABLE_INSTRUMENTATION
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace stats {
+
+class Registry {
+public:
+    static std::atomic<uint64_t>& Get(const std::string& name) {
+        auto& registry = Instance();
+        std::lock_guard lock(registry.mutex_);
+        return registry.values_[name];
+    }
+
+    static void DumpJson(std::ostream& out) {
+        auto& registry = Instance();
+        std::lock_guard lock(registry.mutex_);
+        out << '{';
+        const char* separator = "\n";
+        for (const auto& [name, value] : registry.values_) {
+            out << separator << "  \"" << name << "\": " << value.load();
+            separator = ",\n";
+        }
+        out << "\n}" << std::endl;
+    }
+
+private:
+    static Registry& Instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    std::mutex mutex_;
+    std::map<std::string, std::atomic<uint64_t>> values_;
+};
+
+inline void UpdateMax(std::atomic<uint64_t>& value, uint64_t candidate) {
+    auto current = value.load(std::memory_order_relaxed);
+    while (current < candidate &&
+            !value.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {
+    }
+}
+
+class ScopedTimer {
+public:
+    ScopedTimer(std::atomic<uint64_t>& calls, std::atomic<uint64_t>& nanoseconds)
+        : calls_(calls), nanoseconds_(nanoseconds), start_(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~ScopedTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        calls_.fetch_add(1, std::memory_order_relaxed);
+        nanoseconds_.fetch_add(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+            std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t>& calls_;
+    std::atomic<uint64_t>& nanoseconds_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Tracks the nesting depth of a recursive function and remembers the deepest one.
+class DepthGuard {
+public:
+    DepthGuard(size_t& depth, std::atomic<uint64_t>& maxDepth) : depth_(depth) {
+        UpdateMax(maxDepth, ++depth_);
+    }
+
+    ~DepthGuard() {
+        --depth_;
+    }
+
+private:
+    size_t& depth_;
+};
+
+#ifdef __linux__
+/*
+ * Counts user-space cache and branch misses of the calling thread within a scope.
+ * Opening the events costs a few syscalls, so keep it around whole phases, not inner loops.
+ * If perf_event_open is not permitted (see /proc/sys/kernel/perf_event_paranoid),
+ * nothing is recorded.
+ */
+class ScopedPerfCounters {
+public:
+    explicit ScopedPerfCounters(const char* name)
+        : name_(name), cacheFd_(Open(PERF_COUNT_HW_CACHE_MISSES)), branchFd_(Open(PERF_COUNT_HW_BRANCH_MISSES))
+    {
+    }
+
+    ~ScopedPerfCounters() {
+        Close(cacheFd_, name_ + ".cache_misses");
+        Close(branchFd_, name_ + ".branch_misses");
+    }
+
+private:
+    static int Open(uint64_t config) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+        return fd;
+    }
+
+    static void Close(int fd, const std::string& name) {
+        if (fd < 0) {
+            return;
+        }
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t count = 0;
+        if (read(fd, &count, sizeof(count)) == sizeof(count)) {
+            Registry::Get(name).fetch_add(count, std::memory_order_relaxed);
+        }
+        close(fd);
+    }
+
+    std::string name_;
+    int cacheFd_;
+    int branchFd_;
+};
+#endif
+
+}  // namespace stats
+
+#define STATS_CONCAT_IMPL(a, b) a##b
+#define STATS_CONCAT(a, b) STATS_CONCAT_IMPL(a, b)
+
+#define STATS_VALUE(name) ([]() -> std::atomic<uint64_t>& { \
+    static auto& value = ::stats::Registry::Get(name);         \
+    return value;                                              \
+}())
+
+#define STATS_INCREMENT(name) STATS_VALUE(name).fetch_add(1, std::memory_order_relaxed)
+#define STATS_ADD(name, value) STATS_VALUE(name).fetch_add(value, std::memory_order_relaxed)
+#define STATS_SET(name, value) STATS_VALUE(name).store(value, std::memory_order_relaxed)
+#define STATS_MAX(name, value) ::stats::UpdateMax(STATS_VALUE(name), value)
+
+// Records `name.calls` and `name.ns` for the rest of the enclosing scope.
+#define STATS_SCOPED_TIMER(name) ::stats::ScopedTimer STATS_CONCAT(statsTimer, __LINE__)( \
+    STATS_VALUE(name ".calls"), STATS_VALUE(name ".ns"))
+
+// Records the maximum nesting depth of the enclosing (recursive) function as `name`.
+#define STATS_TRACK_DEPTH(name)                                               \
+    static thread_local size_t STATS_CONCAT(statsDepth, __LINE__) = 0;        \
+    ::stats::DepthGuard STATS_CONCAT(statsDepthGuard, __LINE__)(              \
+        STATS_CONCAT(statsDepth, __LINE__), STATS_VALUE(name))
+
+#ifdef __linux__
+// Records `name.cache_misses` and `name.branch_misses` for the rest of the enclosing scope.
+#define STATS_SCOPED_PERF(name) ::stats::ScopedPerfCounters STATS_CONCAT(statsPerf, __LINE__)(name)
+#else
+#define STATS_SCOPED_PERF(name)
+#endif
+
+#define STATS_DUMP_JSON(out) ::stats::Registry::DumpJson(out)
+
+#else
+
+#define STATS_INCREMENT(name) do {} while (false)
+#define STATS_ADD(name, value) do {} while (false)
+#define STATS_SET(name, value) do {} while (false)
+#define STATS_MAX(name, value) do {} while (false)
+#define STATS_SCOPED_TIMER(name)
+#define STATS_TRACK_DEPTH(name)
+#define STATS_SCOPED_PERF(name)
+#define STATS_DUMP_JSON(out) do {} while (false)
+
+#endif